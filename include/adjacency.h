@@ -0,0 +1,102 @@
+#ifndef ADJACENCY_H_
+#define ADJACENCY_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "ipv4_hash.h"
+
+#define ADJ_MAC_SIZE 6
+#define ADJ_REWRITE_SIZE 14         /* The destination MAC, the source MAC and the ethertype */
+#define ADJ_MAX_CAPACITY (1u << 24)
+
+/*
+ * The resolved next hops and the Ethernet header of the frames sent to
+ * them, built once when the neighbor is resolved, so forwarding a
+ * packet is a lookup and a single copy of the header. An entry is used
+ * until it expires, the neighbor is resolved again by the thread that
+ * owns the table after that.
+ */
+typedef struct adj_entry_s {
+    uint32_t ip;                /* The next hop in network order */
+    int interface;              /* The interface the frames leave on */
+    uint64_t expires;           /* When the rewrite stops being used, in milliseconds */
+    uint8_t rewrite[ADJ_REWRITE_SIZE];
+    uint8_t used;               /* 0 for an empty slot */
+} adj_entry_t;
+
+/*
+ * A fixed-capacity hash table keyed by the next hop, with linear
+ * probing and a quarter of the slots always free. A single thread
+ * changes the table, the sequence counter lets the other threads
+ * read an entry without a lock and retry if it changed meanwhile.
+ * The entries are not removed one by one, they expire, and a full
+ * table is emptied before a new next hop is added.
+ */
+typedef struct adj_table_s {
+    _Atomic uint32_t seq;       /* Odd while the table is changed */
+    adj_entry_t *entries;
+    uint32_t mask;              /* The number of slots - 1, a power of two */
+    uint32_t len;
+    uint32_t capacity;          /* Most next hops stored at once */
+} adj_table_t;
+
+adj_table_t*    create_adj_table    (uint32_t capacity);
+void            free_adj_table      (adj_table_t **__restrict__ table);
+int             adj_table_set       (adj_table_t *__restrict__ table, uint32_t ip, int interface, const uint8_t *dst,
+                                     const uint8_t *src, uint16_t ethertype, uint64_t expires);
+void            adj_table_expire    (adj_table_t *__restrict__ table, uint32_t ip);
+void            adj_table_flush     (adj_table_t *__restrict__ table);
+
+static inline uint32_t adj_table_slot(const adj_table_t *__restrict__ table, uint32_t ip) {
+    return ipv4_hash_slot(ip, table->mask + 1);
+}
+
+/**
+ * @brief Writes the Ethernet header of a frame sent to a next hop, while
+ * the thread that owns the table may change it. The probes are bounded,
+ * so a torn read can not loop, it is just read again.
+ *
+ * @param table the adjacency table
+ * @param ip the next hop in network order
+ * @param interface the interface the frame leaves on
+ * @param now the current time in milliseconds
+ * @param frame receives the rewrite in its first ADJ_REWRITE_SIZE bytes
+ * @return int 0 if the frame was rewritten or -1 if the next hop has to be resolved.
+ */
+static inline int adj_table_lookup(const adj_table_t *__restrict__ table, uint32_t ip, int interface, uint64_t now,
+                                   void *frame) {
+    uint32_t seq;
+    int found;
+
+    do {
+        seq = atomic_load_explicit(&table->seq, memory_order_acquire);
+        found = -1;
+
+        uint32_t slot = adj_table_slot(table, ip);
+
+        for (uint32_t probes = 0; (probes <= table->mask) && (table->entries[slot].used != 0); ++probes) {
+            const adj_entry_t *entry = table->entries + slot;
+
+            if (entry->ip == ip) {
+                if ((entry->interface == interface) && (now < entry->expires)) {
+                    memcpy(frame, entry->rewrite, ADJ_REWRITE_SIZE);
+                    found = 0;
+                }
+
+                break;
+            }
+
+            slot = (slot + 1) & table->mask;
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+    } while (((seq & 1) != 0) || (seq != atomic_load_explicit(&table->seq, memory_order_relaxed)));
+
+    return found;
+}
+
+#endif /* ADJACENCY_H_ */
@@ -0,0 +1,126 @@
+#ifndef ARP_CACHE_H_
+#define ARP_CACHE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "ipv4_hash.h"
+
+#define MAC_ADDR_SIZE 6
+#define ARP_CACHE_DEFAULT_CAPACITY 1024u
+#define ARP_CACHE_MAX_CAPACITY (1u << 24)
+
+#define ARP_TICK_MS 200             /* How often the entries are aged */
+#define ARP_RETRY_MS 1000           /* The time between two requests for an unresolved neighbor */
+#define ARP_MAX_PROBES 3            /* Requests sent before an unresolved neighbor is dropped */
+#define ARP_REACHABLE_MS 30000      /* The time a confirmed MAC address is trusted */
+#define ARP_STALE_MS 60000          /* The time a stale entry is kept without being confirmed again */
+#define ARP_PENDING_MAX 64          /* Packets kept for an unresolved neighbor, the oldest are dropped first */
+
+/*
+ * The states of a neighbor:
+ *  - INCOMPLETE: a request was sent and the packets for the neighbor wait for the reply
+ *  - REACHABLE: the MAC address was confirmed by a reply not long ago
+ *  - STALE: the MAC address is still used, but the next packet sends a request to confirm it
+ */
+typedef enum arp_state_s {
+    ARP_FREE,
+    ARP_INCOMPLETE,
+    ARP_REACHABLE,
+    ARP_STALE
+} arp_state_t;
+
+/* What the forwarding path has to do with a packet for a neighbor */
+typedef enum arp_action_s {
+    ARP_SEND,                   /* Send the packet to the MAC address */
+    ARP_SEND_PROBE,             /* Send the packet and a request to confirm the MAC address */
+    ARP_QUEUE_REQUEST,          /* Queue the packet and send the first request */
+    ARP_QUEUE,                  /* Queue the packet, a request is already on the way */
+    ARP_DROP                    /* The cache is full, the neighbor can not be resolved */
+} arp_action_t;
+
+/* The events raised while the entries are aged */
+typedef enum arp_event_s {
+    ARP_RETRY,                  /* A request has to be sent again */
+    ARP_FAILED                  /* The neighbor did not reply and was dropped */
+} arp_event_t;
+
+typedef void (*arp_cache_fn)(uint32_t ip, int interface, arp_event_t event, void *arg);
+
+/*
+ * A packet that waits for the MAC address of its next hop. The link
+ * is the first field of the caller's packet, so the packets are
+ * chained without allocating list cells.
+ */
+typedef struct arp_pending_s {
+    struct arp_pending_s *next;
+} arp_pending_t;
+
+typedef void (*arp_drop_fn)(arp_pending_t *packet, void *arg);
+
+/*
+ * A fixed-capacity hash table keyed by the IPv4 address, with linear
+ * probing. The table keeps at least a quarter of its slots free, so
+ * the probe sequences stay short, and a deletion shifts the following
+ * entries back instead of leaving tombstones. The callers serialize
+ * every function that uses the table.
+ */
+typedef struct arp_cache_entry_s {
+    uint32_t ip;
+    uint8_t mac[MAC_ADDR_SIZE];
+    uint8_t state;              /* ARP_FREE for an empty slot */
+    uint8_t probes;             /* Requests sent since the MAC address was confirmed */
+    int interface;              /* The interface the requests are sent on */
+    uint64_t confirmed;         /* When the MAC address was confirmed, in milliseconds */
+    uint64_t probed;            /* When the last request was sent, in milliseconds */
+
+    arp_pending_t *pending;     /* The packets waiting for the MAC address, oldest first */
+    arp_pending_t *pending_tail;
+    uint32_t pending_len;
+} arp_cache_entry_t;
+
+typedef struct arp_cache_s {
+    arp_cache_entry_t *entries;
+    uint32_t mask;              /* The number of slots - 1, a power of two */
+    uint32_t len;
+    uint32_t capacity;          /* Most entries stored at once */
+    arp_drop_fn drop;           /* Frees the waiting packets that are dropped */
+    void *drop_arg;
+} arp_cache_t;
+
+arp_cache_t*    create_arp_cache    (uint32_t capacity, arp_drop_fn drop, void *drop_arg);
+void            free_arp_cache      (arp_cache_t **__restrict__ cache);
+arp_action_t    arp_cache_resolve   (arp_cache_t *__restrict__ cache, uint32_t ip, int interface, uint64_t now,
+                                     const uint8_t **mac);
+int             arp_cache_update    (arp_cache_t *__restrict__ cache, uint32_t ip, const uint8_t *mac,
+                                     arp_state_t state, uint64_t now, int create);
+int             arp_cache_enqueue   (arp_cache_t *__restrict__ cache, uint32_t ip, arp_pending_t *packet);
+arp_pending_t*  arp_cache_take      (arp_cache_t *__restrict__ cache, uint32_t ip);
+int             arp_cache_remove    (arp_cache_t *__restrict__ cache, uint32_t ip);
+void            arp_cache_age       (arp_cache_t *__restrict__ cache, uint64_t now, arp_cache_fn fn, void *arg);
+void            arp_cache_flush     (arp_cache_t *__restrict__ cache);
+
+static inline uint32_t arp_cache_slot(const arp_cache_t *__restrict__ cache, uint32_t ip) {
+    return ipv4_hash_slot(ip, cache->mask + 1);
+}
+
+/**
+ * @brief Finds the entry of an IPv4 address.
+ *
+ * @param cache the ARP cache
+ * @param ip the address in network order
+ * @return arp_cache_entry_t* the entry or NULL if the address is not cached.
+ */
+static inline arp_cache_entry_t* arp_cache_find(const arp_cache_t *__restrict__ cache, uint32_t ip) {
+    for (uint32_t slot = arp_cache_slot(cache, ip); cache->entries[slot].state != ARP_FREE; slot = (slot + 1) & cache->mask) {
+        if (cache->entries[slot].ip == ip) {
+            return cache->entries + slot;
+        }
+    }
+
+    return NULL;
+}
+
+#endif /* ARP_CACHE_H_ */
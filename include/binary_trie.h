@@ -6,7 +6,11 @@
 #include <string.h>
 #include <stdint.h>
 
-#define MAX_LINE_SIZE 64
+#define BTRIE_ROOT 0u
+#define BTRIE_NIL 0u
+#define BTRIE_EMPTY 0u
+#define BTRIE_INIT_NODES 1024u
+#define BTRIE_BATCH_WIDTH 8
 
 typedef enum hop_status_s {
     VALID,
@@ -19,29 +23,51 @@ typedef struct hop_info_s {
     hop_status_t status;
 } hop_info_t;
 
-typedef enum bnode_status_s {
-    DUMMY,
-    EMPTY,
-    INFO
-} bnode_status_t;
-
+/*
+ * The nodes live in one arena and link their children by index.
+ * The root is always the node 0, so 0 also marks a missing child.
+ * The info field is BTRIE_EMPTY for nodes that only lead to other
+ * prefixes, otherwise it keeps the index + 1 of the next hop.
+ */
 typedef struct btrie_node_s {
-    bnode_status_t type;
-    uint32_t hop;
-    int interface;
-    struct btrie_node_s *left;
-    struct btrie_node_s *right;
+    uint32_t left;
+    uint32_t right;
+    uint32_t info;
 } btrie_node_t;
 
 typedef struct btrie_s {
-    btrie_node_t *root;
+    btrie_node_t *nodes;        /* The arena of the trie nodes */
+    uint32_t nodes_len;
+    uint32_t nodes_cap;
+
+    hop_info_t *hops;           /* The next hops referenced by the INFO nodes */
+    uint32_t hops_len;
+    uint32_t hops_cap;
+
+    uint32_t nodes_free;        /* The pruned nodes, linked by their left child */
+    uint32_t hops_free;         /* The released hop slots + 1, linked by their hop field */
+
     size_t size;
+
+    void *image;                /* The mapped snapshot holding the arrays, NULL for heap arrays */
+    size_t image_size;
 } btrie_t;
 
+typedef void (*btrie_walk_fn)(uint32_t prefix, uint32_t mask, uint32_t hop, int interface, void *arg);
+
 btrie_t*        create_btrie    (void);
 void            free_btrie      (btrie_t **__restrict__ tree);
-void            btrie_insert    (btrie_t *__restrict__ tree, uint32_t prefix, uint32_t mask, uint32_t hop, int interface);
-hop_info_t*     btrie_lpm       (btrie_t *__restrict tree, uint32_t addr);
+btrie_t*        btrie_clone     (const btrie_t *__restrict__ tree);
+int             btrie_insert    (btrie_t *__restrict__ tree, uint32_t prefix, uint32_t mask, uint32_t hop, int interface);
+int             btrie_replace   (btrie_t *__restrict__ tree, uint32_t prefix, uint32_t mask, uint32_t hop, int interface);
+int             btrie_delete    (btrie_t *__restrict__ tree, uint32_t prefix, uint32_t mask);
+hop_status_t    btrie_lookup    (const btrie_t *__restrict__ tree, uint32_t addr, hop_info_t *__restrict__ info);
+void            btrie_lookup_batch  (const btrie_t *__restrict__ tree, const uint32_t *__restrict__ addrs,
+                                     hop_info_t *__restrict__ infos, size_t count);
+hop_status_t    btrie_cover     (const btrie_t *__restrict__ tree, uint32_t prefix, uint32_t mask,
+                                 hop_info_t *__restrict__ info, uint32_t *__restrict__ cover_mask);
 btrie_t*        btrie_rtable    (const char *filename);
+void            btrie_walk      (const btrie_t *__restrict__ tree, btrie_walk_fn fn, void *arg);
+int             btrie_thaw      (btrie_t *__restrict__ tree);
 
 #endif /* BINARY_TRIE_H_ */
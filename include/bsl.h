@@ -0,0 +1,51 @@
+#ifndef BSL_H_
+#define BSL_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "binary_trie.h"
+
+#define BSL_MAX_LENGTHS 32
+
+/* The value of a used entry, the low bits keep the index + 1 of the best matching prefix */
+#define BSL_USED (1u << 31)
+#define BSL_BMP_MASK (~BSL_USED)
+
+typedef struct bsl_entry_s {
+    uint32_t key;               /* The prefix (or the marker) in host order */
+    uint32_t value;             /* 0 for a free entry, otherwise BSL_USED and the best matching prefix */
+} bsl_entry_t;
+
+typedef struct bsl_table_s {
+    bsl_entry_t *entries;       /* Open addressing with linear probing */
+    uint32_t mask;              /* Capacity - 1, the capacity is a power of 2 */
+    uint32_t len;
+} bsl_table_t;
+
+/*
+ * One hash table for every prefix length that appears in the routing
+ * table. A lookup does a binary search over the lengths: a hit (a real
+ * prefix or a marker left by a longer prefix) moves the search to the
+ * longer lengths, a miss moves it to the shorter ones. Every entry
+ * remembers its best matching prefix, so a marker never needs to
+ * backtrack.
+ */
+typedef struct bsl_s {
+    bsl_table_t tables[BSL_MAX_LENGTHS + 1];
+    uint8_t lengths[BSL_MAX_LENGTHS];       /* The distinct prefix lengths, sorted */
+    uint32_t lengths_len;
+
+    hop_info_t *hops;           /* The next hops referenced by the entries */
+    uint32_t hops_len;
+
+    size_t size;
+} bsl_t;
+
+void            free_bsl        (bsl_t **__restrict__ bsl);
+hop_status_t    bsl_lookup      (const bsl_t *__restrict__ bsl, uint32_t addr, hop_info_t *__restrict__ info);
+bsl_t*          bsl_build       (const btrie_t *__restrict__ tree);
+
+#endif /* BSL_H_ */
@@ -0,0 +1,41 @@
+#ifndef BTRIE_IMAGE_H_
+#define BTRIE_IMAGE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "binary_trie.h"
+
+#define BTRIE_IMAGE_MAGIC 0x42495246u     /* "FRIB" on little endian hosts */
+#define BTRIE_IMAGE_VERSION 1u
+#define BTRIE_IMAGE_ALIGN 64u
+
+/*
+ * A snapshot of the binary trie is the header followed by the node
+ * arena and the hop table, both aligned to a cache line. The nodes
+ * link their children by index, so the image is used in place from
+ * any address it is mapped at. The sizes of the records are stored
+ * to reject images written by a build with another layout.
+ */
+typedef struct btrie_image_header_s {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t node_size;         /* sizeof(btrie_node_t) of the writer */
+    uint32_t hop_size;          /* sizeof(hop_info_t) of the writer */
+
+    uint32_t nodes_len;
+    uint32_t hops_len;
+    uint64_t size;              /* Number of routes */
+
+    uint64_t nodes_offset;      /* Offsets from the start of the image */
+    uint64_t hops_offset;
+    uint64_t image_size;
+} btrie_image_header_t;
+
+int             btrie_is_image  (const char *filename);
+int             btrie_save      (const btrie_t *__restrict__ tree, const char *filename);
+btrie_t*        btrie_load      (const char *filename);
+
+#endif /* BTRIE_IMAGE_H_ */
@@ -0,0 +1,56 @@
+#ifndef CONTROL_H_
+#define CONTROL_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/un.h>
+
+#include "fib.h"
+#include "rcu.h"
+#include "rtable.h"
+
+#define CONTROL_BUF_SIZE 65536
+#define CONTROL_BATCH_SIZE 4096     /* Most route updates published at once */
+
+/*
+ * A thread serving a Unix socket with one command per line:
+ *  - add prefix next_hop mask interface (the format of the routing table)
+ *  - del prefix mask
+ *  - lookup address
+ *  - show [routes]
+ *  - flush-arp
+ * The route updates are applied to a shadow copy of the published FIB,
+ * the shadow is published and, after a grace period of the readers,
+ * the same updates are applied to the old FIB, which becomes the next
+ * shadow. So the updates stay incremental and the forwarding thread
+ * never sees a FIB that is being changed.
+ */
+typedef struct control_s {
+    pthread_t thread;
+    int listen_fd;
+    int stop_fd;                /* An eventfd that wakes the thread up when it has to stop */
+    char path[sizeof(((struct sockaddr_un *)NULL)->sun_path)];
+
+    fib_t *_Atomic *fib;        /* Where the FIB is published */
+    rcu_t *rcu;                 /* The domain of the forwarding threads */
+    pthread_mutex_t *lock;      /* Serializes the writers of the published FIB */
+    atomic_int *flush_arp;      /* Asks the forwarding thread to drop its ARP cache */
+    int interfaces;             /* The routes leave on the interfaces 0 .. interfaces - 1 */
+
+    fib_t *shadow;              /* The copy of the published FIB that receives the updates */
+    uint64_t shadow_of;         /* The id of the published FIB the shadow is a copy of */
+
+    fib_update_t *updates;      /* The pending updates, applied to the shadow */
+    fib_update_t *replay;       /* The same updates, applied to the old FIB */
+    size_t updates_len;
+} control_t;
+
+control_t*      create_control  (const char *path, fib_t *_Atomic *fib, rcu_t *rcu,
+                                 pthread_mutex_t *lock, atomic_int *flush_arp, int interfaces);
+void            free_control    (control_t **__restrict__ control);
+
+#endif /* CONTROL_H_ */
@@ -0,0 +1,83 @@
+#ifndef CSUM_H_
+#define CSUM_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/*
+ * The Internet checksum (RFC 1071). The sums are taken over the bytes
+ * in memory order, the one's complement sum does not depend on the
+ * byte order, so a folded sum is stored in a header as it is and the
+ * words of a header are passed to the incremental updates as they are
+ * stored, in network order. A partial sum is continued just after an
+ * even number of bytes.
+ */
+uint64_t        csum_partial        (const void *data, size_t len, uint64_t sum);
+const char*     csum_kernel         (void);
+int             csum_select_kernel  (const char *name);
+
+/**
+ * @brief Adds two partial sums with the end around carry.
+ *
+ * @param sum a partial sum
+ * @param value another partial sum
+ * @return uint64_t the partial sum of both.
+ */
+static inline uint64_t csum_add(uint64_t sum, uint64_t value) {
+    sum += value;
+
+    return sum + (sum < value);
+}
+
+/**
+ * @brief Folds a partial sum into the checksum that is stored in a header.
+ *
+ * @param sum the partial sum
+ * @return uint16_t the one's complement of the folded sum, 0 when the
+ * sum covered a header together with its valid checksum.
+ */
+static inline uint16_t csum_fold(uint64_t sum) {
+    sum = (sum & 0xffffffffu) + (sum >> 32);
+    sum = (sum & 0xffffffffu) + (sum >> 32);
+    sum = (sum & 0xffffu) + (sum >> 16);
+    sum = (sum & 0xffffu) + (sum >> 16);
+
+    return (uint16_t)~sum;
+}
+
+/**
+ * @brief Updates a checksum after a 16-bit word of the data changed,
+ * following RFC 1624: HC' = ~(~HC + ~m + m').
+ *
+ * @param check the checksum as it is stored
+ * @param old the old word as it was stored
+ * @param new the new word as it is stored
+ * @return uint16_t the checksum to store.
+ */
+static inline uint16_t csum_update16(uint16_t check, uint16_t old, uint16_t new) {
+    uint32_t sum = (uint32_t)(uint16_t)~check + (uint16_t)~old + new;
+
+    sum = (sum & 0xffffu) + (sum >> 16);
+    sum = (sum & 0xffffu) + (sum >> 16);
+
+    return (uint16_t)~sum;
+}
+
+/**
+ * @brief Updates a checksum after a 32-bit word of the data changed,
+ * as two 16-bit updates, an IPv4 address for example.
+ *
+ * @param check the checksum as it is stored
+ * @param old the old word as it was stored
+ * @param new the new word as it is stored
+ * @return uint16_t the checksum to store.
+ */
+static inline uint16_t csum_update32(uint16_t check, uint32_t old, uint32_t new) {
+    check = csum_update16(check, (uint16_t)old, (uint16_t)new);
+
+    return csum_update16(check, (uint16_t)(old >> 16), (uint16_t)(new >> 16));
+}
+
+#endif /* CSUM_H_ */
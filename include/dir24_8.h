@@ -0,0 +1,55 @@
+#ifndef DIR24_8_H_
+#define DIR24_8_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "binary_trie.h"
+
+#define DIR24_8_TBL24_SIZE (1u << 24)
+#define DIR24_8_TBL8_SIZE (1u << 8)
+
+/*
+ * Every table entry is a 32-bit word:
+ *  - bit 31 marks a valid route
+ *  - bit 30 marks a tbl24 entry that points to a tbl8 group
+ *  - bits 24..29 keep the length of the prefix that wrote the entry
+ *  - bits 0..23 keep the next hop index or the tbl8 group index
+ */
+#define DIR24_8_VALID (1u << 31)
+#define DIR24_8_EXT (1u << 30)
+#define DIR24_8_DEPTH_SHIFT 24
+#define DIR24_8_DEPTH_MASK (0x3fu << DIR24_8_DEPTH_SHIFT)
+#define DIR24_8_INDEX_MASK 0x00ffffffu
+
+typedef struct dir24_8_s {
+    uint32_t *tbl24;            /* Direct index on the first 24 bits of the address */
+    uint32_t *tbl8;             /* Groups of 256 entries for the prefixes longer than 24 bits */
+    uint32_t tbl8_len;          /* Number of tbl8 groups handed out, the free ones included */
+    uint32_t tbl8_cap;          /* Number of tbl8 groups allocated */
+    uint32_t tbl8_free;         /* The first free group + 1, chained through its first entry, 0 for none */
+
+    /*
+     * Every distinct next hop is stored once and counts the table
+     * entries that point at it, a slot is freed with its last entry.
+     * The map finds the slot of a next hop with linear probing.
+     */
+    hop_info_t *hops;           /* The next hops referenced by the table entries */
+    uint32_t *hop_refs;         /* The entries pointing at every slot */
+    uint32_t *hop_map;          /* The slot + 1 of the next hops, 0 for an empty bucket, 2 * hops_cap buckets */
+    uint32_t hops_len;          /* Number of slots handed out, the free ones included */
+    uint32_t hops_cap;
+    uint32_t hops_free;         /* The first free slot + 1, chained through its hop field, 0 for none */
+} dir24_8_t;
+
+dir24_8_t*      create_dir24_8  (void);
+void            free_dir24_8    (dir24_8_t **__restrict__ table);
+int             dir24_8_insert  (dir24_8_t *__restrict__ table, uint32_t prefix, uint32_t mask, uint32_t hop, int interface);
+int             dir24_8_delete  (dir24_8_t *__restrict__ table, uint32_t prefix, uint32_t mask,
+                                 const hop_info_t *__restrict__ cover, uint32_t cover_mask);
+hop_status_t    dir24_8_lookup  (const dir24_8_t *__restrict__ table, uint32_t addr, hop_info_t *__restrict__ info);
+dir24_8_t*      dir24_8_build   (const btrie_t *__restrict__ tree);
+
+#endif /* DIR24_8_H_ */
@@ -0,0 +1,78 @@
+#ifndef FIB_H_
+#define FIB_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "binary_trie.h"
+
+/*
+ * The operations of a lookup engine. Every engine is built from the
+ * binary trie that keeps the routes (the RIB), the updates are first
+ * applied to the trie and then handed to the engine, which may apply
+ * them incrementally or rebuild itself from the trie. The batch
+ * lookup is optional, engines without it are called for every address.
+ * Engines that rebuild themselves also give the rebuild, so a batch
+ * of updates costs a single rebuild.
+ */
+typedef struct fib_ops_s {
+    const char *name;
+
+    void*           (*build)    (btrie_t *rib);
+    hop_status_t    (*lookup)   (const void *engine, uint32_t addr, hop_info_t *info);
+    void            (*lookup_batch) (const void *engine, const uint32_t *addrs, hop_info_t *infos, size_t count);
+    int             (*insert)   (void **engine, btrie_t *rib, uint32_t prefix, uint32_t mask, uint32_t hop, int interface);
+    int             (*delete)   (void **engine, btrie_t *rib, uint32_t prefix, uint32_t mask);
+    int             (*rebuild)  (void **engine, btrie_t *rib);
+    void            (*free)     (void **engine);
+} fib_ops_t;
+
+typedef enum fib_update_op_s {
+    FIB_INSERT,
+    FIB_DELETE
+} fib_update_op_t;
+
+typedef struct fib_update_s {
+    fib_update_op_t op;
+    uint32_t prefix;
+    uint32_t mask;
+    uint32_t hop;               /* Just for insertions */
+    int interface;              /* Just for insertions */
+    int status;                 /* Receives 0 if the route was updated or -1 otherwise */
+} fib_update_t;
+
+typedef struct fib_s {
+    const fib_ops_t *ops;       /* The engine used for the longest prefix match */
+    btrie_t *rib;               /* The routes as they were inserted */
+    void *engine;               /* The lookup structure built from the routes */
+    uint64_t id;                /* Unique for every FIB built, even if an address is reused */
+} fib_t;
+
+const fib_ops_t*    fib_find_ops    (const char *name);
+
+fib_t*              fib_build       (const fib_ops_t *ops, btrie_t *rib);
+fib_t*              fib_clone       (const fib_t *__restrict__ fib);
+fib_t*              fib_rtable      (const char *name, const char *filename);
+void                free_fib        (fib_t **__restrict__ fib);
+int                 fib_insert      (fib_t *__restrict__ fib, uint32_t prefix, uint32_t mask, uint32_t hop, int interface);
+int                 fib_replace     (fib_t *__restrict__ fib, uint32_t prefix, uint32_t mask, uint32_t hop, int interface);
+int                 fib_delete      (fib_t *__restrict__ fib, uint32_t prefix, uint32_t mask);
+int                 fib_update      (fib_t *__restrict__ fib, fib_update_t *__restrict__ updates, size_t count);
+void                fib_lookup_batch    (const fib_t *__restrict__ fib, const uint32_t *__restrict__ addrs,
+                                         hop_info_t *__restrict__ infos, size_t count);
+
+/**
+ * @brief Computes the longest prefix match with the engine of the FIB.
+ *
+ * @param fib the forwarding information base
+ * @param addr the address to match in network order
+ * @param info caller storage that receives the next hop and interface
+ * @return hop_status_t VALID if a route was found or INVALID otherwise.
+ */
+static inline hop_status_t fib_lookup(const fib_t *__restrict__ fib, uint32_t addr, hop_info_t *__restrict__ info) {
+    return fib->ops->lookup(fib->engine, addr, info);
+}
+
+#endif /* FIB_H_ */
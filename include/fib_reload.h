@@ -0,0 +1,43 @@
+#ifndef FIB_RELOAD_H_
+#define FIB_RELOAD_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/stat.h>
+
+#include "fib.h"
+#include "rcu.h"
+
+#define FIB_RELOAD_SIGNAL SIGHUP
+#define FIB_RELOAD_INTERVAL_MS 1000
+
+/*
+ * A thread that rebuilds the FIB from the routing table file when the
+ * reload signal is received or when the file changes, the new FIB is
+ * published in place of the old one, which is freed after a grace
+ * period of the readers. The forwarding path just loads the pointer.
+ */
+typedef struct fib_reload_s {
+    pthread_t thread;
+    atomic_int stop;
+
+    const char *path;           /* The routing table file that is watched */
+    const char *engine;         /* The engine of the rebuilt FIBs */
+    struct stat st;             /* The state of the file at the last build */
+
+    fib_t *_Atomic *fib;        /* Where the FIB is published */
+    rcu_t *rcu;                 /* The domain of the forwarding threads */
+    pthread_mutex_t *lock;      /* Serializes the writers of the published FIB */
+} fib_reload_t;
+
+fib_reload_t*   create_fib_reload   (const char *path, const char *engine, fib_t *_Atomic *fib,
+                                     rcu_t *rcu, pthread_mutex_t *lock);
+void            free_fib_reload     (fib_reload_t **__restrict__ reload);
+int             fib_reload          (fib_reload_t *__restrict__ reload);
+
+#endif /* FIB_RELOAD_H_ */
@@ -0,0 +1,61 @@
+#ifndef IFACE_H_
+#define IFACE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <net/if.h>
+
+#define IFACE_MAC_SIZE 6
+#define IFACE_NETLINK_BUF_SIZE 8192
+
+/*
+ * The addresses of an interface, read once when the router starts and
+ * then kept up to date from the netlink link and address events, so
+ * the packet handlers read them from memory instead of asking the
+ * kernel for every packet. A single thread applies the events, the
+ * sequence counter lets the other threads read the addresses without
+ * a lock and retry if an event changed them meanwhile.
+ */
+typedef struct iface_s {
+    _Atomic uint32_t seq;       /* Odd while the addresses are changed */
+    char name[IFNAMSIZ];
+    int ifindex;
+    uint8_t mac[IFACE_MAC_SIZE];
+    uint32_t ipv4;              /* In network order, 0 if the interface has no address */
+    uint32_t mtu;
+} iface_t;
+
+int             iface_init          (iface_t *__restrict__ iface, const char *name, int fd);
+int             iface_netlink_open  (void);
+int             iface_netlink_process   (int fd, iface_t *__restrict__ ifaces, size_t len);
+
+/**
+ * @brief Reads the MAC and the IPv4 addresses of an interface while
+ * another thread may change them.
+ *
+ * @param iface the interface
+ * @param mac receives the MAC address, NULL if not needed
+ * @param ipv4 receives the IPv4 address, NULL if not needed
+ */
+static inline void iface_read(const iface_t *__restrict__ iface, uint8_t *mac, uint32_t *ipv4) {
+    uint32_t seq;
+
+    do {
+        seq = atomic_load_explicit(&iface->seq, memory_order_acquire);
+
+        if (mac != NULL) {
+            memcpy(mac, iface->mac, IFACE_MAC_SIZE);
+        }
+
+        if (ipv4 != NULL) {
+            *ipv4 = iface->ipv4;
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+    } while (((seq & 1) != 0) || (seq != atomic_load_explicit(&iface->seq, memory_order_relaxed)));
+}
+
+#endif /* IFACE_H_ */
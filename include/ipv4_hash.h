@@ -0,0 +1,19 @@
+#ifndef IPV4_HASH_H_
+#define IPV4_HASH_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Maps an IPv4 address to a slot of a hash table keyed by it. The
+ * multiplication mixes every byte of the address into the high bits, which
+ * are scaled to the number of slots.
+ *
+ * @param ip the address in network order
+ * @param slots the number of slots of the table
+ * @return uint32_t the slot, less than slots.
+ */
+static inline uint32_t ipv4_hash_slot(uint32_t ip, uint32_t slots) {
+    return (uint32_t)(((uint64_t)(ip * 0x9e3779b1u) * slots) >> 32);
+}
+
+#endif /* IPV4_HASH_H_ */
@@ -7,7 +7,11 @@
 #include <stdlib.h>
 
 #define MAX_PACKET_LEN 1600
-#define ROUTER_NUM_INTERFACES 3
+#define BURST_SIZE 32
+
+/* The ways the frames are read from and written to the interfaces */
+#define IO_BACKEND_SOCKET 0     /* read/write and recvmmsg/sendmmsg on raw sockets */
+#define IO_BACKEND_RING 1       /* TPACKET_V3 receive rings and TPACKET_V2 send rings */
 
 int send_to_link(int interface, char *frame_data, size_t length);
 
@@ -22,6 +26,54 @@ int send_to_link(int interface, char *frame_data, size_t length);
  */
 int recv_from_any_link(char *frame_data, size_t *length);
 
+#define RECV_TIMEOUT (-2)
+
+/*
+ * @brief Receives a packet, waiting at most timeout_ms milliseconds.
+ *
+ * @param frame_data - as for recv_from_any_link
+ * @param length - as for recv_from_any_link
+ * @param timeout_ms - the most time to wait, a negative value waits forever
+ * Returns: the interface it has been received from or RECV_TIMEOUT.
+ */
+int recv_from_any_link_timeout(char *frame_data, size_t *length, int timeout_ms);
+
+/* A frame of a burst */
+struct frame {
+    char *data;         /* Set by the caller, at least MAX_PACKET_LEN bytes */
+    size_t len;
+    int interface;
+};
+
+/*
+ * @brief Receives a burst of packets. The ready interfaces share the
+ * burst and are served round robin, each with a single recvmmsg call,
+ * an interface that was not drained is served again by the next burst
+ * after the others. With the ring backend the frames are
+ * not copied, their data points in the receive ring and stays valid
+ * until the next burst is received.
+ *
+ * @param frames - the buffers to receive in, count frames at most
+ * @param count - the most frames received, at most BURST_SIZE
+ * @param timeout_ms - the most time to wait, a negative value waits forever
+ * Returns: the number of frames received or RECV_TIMEOUT.
+ */
+int recv_burst_from_any_link(struct frame *frames, size_t count, int timeout_ms);
+
+/*
+ * @brief Queues a packet on the interface, the queue is sent with a
+ * single sendmmsg call when it is full or flushed. The frame is not
+ * copied, it must stay unchanged until the queue is flushed.
+ */
+void send_to_link_burst(int interface, char *frame_data, size_t length);
+
+/* Sends the packets queued on an interface or on every interface */
+void flush_link(int interface);
+void flush_links(void);
+
+/* The number of interfaces named on the command line */
+int get_num_interfaces(void);
+
 /* Route table entry */
 struct route_table_entry {
     uint32_t prefix;
@@ -36,6 +88,11 @@ struct arp_entry {
     uint8_t mac[6];
 };
 
+/*
+ * The addresses of the interfaces are cached when the router starts
+ * and refreshed from the netlink events while the router waits for
+ * packets, so the getters below do not issue any syscall.
+ */
 char *get_interface_ip(int interface);
 uint32_t get_interface_ipv4(int interface);
 
@@ -89,6 +146,28 @@ int parse_arp_table(char *path, struct arp_entry *arp_table);
 
 void init(int argc, char *argv[]);
 
+#define LINKS_FANOUT 1		/* Share the frames of every interface with the other threads by the hash of their flow */
+#define LINKS_SEND 2		/* Just send the frames with plain sockets, nothing is received */
+#define LINKS_NETLINK 4		/* Apply the netlink events of the interfaces while waiting */
+
+#define WAIT_EVENT 1		/* The fd passed to wait_event can be read */
+#define WAIT_NETLINK 2		/* The address of an interface changed while waiting */
+
+/*
+ * Reads the addresses of the interfaces and sets the IO_BACKEND_* used
+ * by the threads, every thread that sends or receives frames opens its
+ * own sockets with init_links and the LINKS_* flags. A single thread
+ * takes LINKS_NETLINK.
+ */
+void init_backend(int argc, char *argv[], int backend);
+void init_links(int flags);
+
+/*
+ * Waits until fd can be read or the timeout expires, for the threads
+ * that do not receive frames. Returns the WAIT_* that happened or 0.
+ */
+int wait_event(int fd, int timeout_ms);
+
 #define DIE(condition, message, ...) \
     do { \
         if ((condition)) { \
@@ -0,0 +1,66 @@
+#ifndef PACKET_POOL_H_
+#define PACKET_POOL_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define PACKET_POOL_ALIGN 64u
+#define PACKET_POOL_DEFAULT_SIZE 4096u
+#define PACKET_POOL_MAX_SIZE (1u << 20)
+
+/*
+ * A fixed number of equal buffers carved from one cache aligned
+ * allocation. The free buffers are linked through their first bytes,
+ * so both the allocation and the release just pop or push the head
+ * of the free list. The pool is not thread safe, the threads that
+ * share it serialize the calls.
+ */
+typedef struct packet_pool_free_s {
+    struct packet_pool_free_s *next;
+} packet_pool_free_t;
+
+typedef struct packet_pool_s {
+    char *memory;               /* The buffers, every one starts on a cache line */
+    size_t stride;              /* The size of a buffer rounded up to the cache line */
+    uint32_t count;
+    uint32_t available;         /* The buffers in the free list */
+    packet_pool_free_t *free;
+} packet_pool_t;
+
+packet_pool_t*  create_packet_pool  (uint32_t count, size_t size);
+void            free_packet_pool    (packet_pool_t **__restrict__ pool);
+
+/**
+ * @brief Takes a buffer from the pool.
+ *
+ * @param pool the packet pool
+ * @return void* a buffer of the pool size or NULL if every buffer is in use.
+ */
+static inline void* packet_pool_alloc(packet_pool_t *__restrict__ pool) {
+    packet_pool_free_t *buffer = pool->free;
+
+    if (buffer != NULL) {
+        pool->free = buffer->next;
+        --(pool->available);
+    }
+
+    return buffer;
+}
+
+/**
+ * @brief Gives a buffer back to the pool.
+ *
+ * @param pool the packet pool
+ * @param buffer a buffer taken from the same pool or NULL
+ */
+static inline void packet_pool_release(packet_pool_t *__restrict__ pool, void *buffer) {
+    if (buffer != NULL) {
+        ((packet_pool_free_t *)buffer)->next = pool->free;
+        pool->free = buffer;
+        ++(pool->available);
+    }
+}
+
+#endif /* PACKET_POOL_H_ */
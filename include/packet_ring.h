@@ -0,0 +1,47 @@
+#ifndef PACKET_RING_H_
+#define PACKET_RING_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <linux/if_packet.h>
+
+#define PACKET_RING_BLOCK_SIZE (1u << 18)
+#define PACKET_RING_BLOCK_COUNT 16u
+#define PACKET_RING_FRAME_SIZE 2048u
+#define PACKET_RING_RETIRE_MS 1u
+#define PACKET_RING_TX_FRAMES 512u
+
+/*
+ * The PACKET_MMAP rings of an interface. The kernel writes the
+ * received frames in the blocks of a TPACKET_V3 ring, which the
+ * router reads and rewrites in place and gives back a block at a
+ * time. The frames to send are copied in the slots of a TPACKET_V2
+ * ring, that the kernel sends all at once when it is kicked. A socket
+ * has a single ring version, so every ring has its own socket.
+ */
+typedef struct packet_ring_s {
+    int rx_fd;
+    uint8_t *rx_map;
+    size_t rx_size;
+    uint32_t rx_block;          /* The block read by the router */
+    uint32_t rx_left;           /* The frames of the block that were not read yet */
+    struct tpacket3_hdr *rx_frame;  /* The next frame of the block */
+
+    int tx_fd;
+    uint8_t *tx_map;
+    size_t tx_size;
+    uint32_t tx_head;           /* The next slot filled by the router */
+    uint32_t tx_pending;        /* The slots filled since the last kick */
+} packet_ring_t;
+
+int             packet_ring_open    (packet_ring_t *__restrict__ ring, const char *name);
+void            packet_ring_close   (packet_ring_t *__restrict__ ring);
+size_t          packet_ring_recv    (packet_ring_t *__restrict__ ring, char **frames, size_t *lens, size_t count);
+void            packet_ring_release (packet_ring_t *__restrict__ ring);
+int             packet_ring_ready   (const packet_ring_t *__restrict__ ring);
+int             packet_ring_send    (packet_ring_t *__restrict__ ring, const char *frame, size_t len);
+int             packet_ring_flush   (packet_ring_t *__restrict__ ring);
+
+#endif /* PACKET_RING_H_ */
@@ -0,0 +1,53 @@
+#ifndef POPTRIE_H_
+#define POPTRIE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "binary_trie.h"
+
+#define POPTRIE_DIRECT_BITS 16
+#define POPTRIE_STRIDE 6
+#define POPTRIE_FANOUT (1u << POPTRIE_STRIDE)
+
+/* Direct pointing entries with this bit set hold a leaf instead of a node index */
+#define POPTRIE_LEAF (1u << 31)
+
+/*
+ * A node resolves 6 bits of the address. The bit i of the vector is
+ * set when the child i is another node, the bit i of the leafvec is
+ * set when a new run of equal leaves starts at the child i. Children
+ * and leaves are stored contiguously from base1 and base0, so their
+ * position is given by the popcount of the bitmaps below the index.
+ */
+typedef struct poptrie_node_s {
+    uint64_t vector;
+    uint64_t leafvec;
+    uint32_t base0;
+    uint32_t base1;
+} poptrie_node_t;
+
+typedef struct poptrie_s {
+    uint32_t *direct;           /* Direct pointing on the first 16 bits of the address */
+
+    poptrie_node_t *nodes;
+    uint32_t nodes_len;
+    uint32_t nodes_cap;
+
+    uint32_t *leaves;           /* The index + 1 of the next hop, 0 when no route matches */
+    uint32_t leaves_len;
+    uint32_t leaves_cap;
+
+    hop_info_t *hops;           /* The next hops referenced by the leaves */
+    uint32_t hops_len;
+
+    size_t size;
+} poptrie_t;
+
+void            free_poptrie    (poptrie_t **__restrict__ trie);
+hop_status_t    poptrie_lookup  (const poptrie_t *__restrict__ trie, uint32_t addr, hop_info_t *__restrict__ info);
+poptrie_t*      poptrie_build   (const btrie_t *__restrict__ tree);
+
+#endif /* POPTRIE_H_ */
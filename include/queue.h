@@ -4,11 +4,14 @@
 struct queue;
 typedef struct queue *queue;
 
-/* create an empty queue */
+/* create an empty queue, NULL if the memory could not be allocated */
 extern queue queue_create(void);
 
-/* insert an element at the end of the queue */
-extern void queue_enq(queue q, void *element);
+/*
+ * insert an element at the end of the queue, 0 on success or -1 if the
+ * queue already holds RING_MAX_SIZE elements or could not grow
+ */
+extern int queue_enq(queue q, void *element);
 
 /* delete the front element on the queue and return it */
 extern void *queue_deq(queue q);
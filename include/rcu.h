@@ -0,0 +1,70 @@
+#ifndef RCU_H_
+#define RCU_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define RCU_OFFLINE 0u
+#define RCU_WAIT_US 50
+
+/*
+ * Quiescent state based reclamation. Every reader thread registers a
+ * reader and announces the grace period it has seen between two uses
+ * of the shared data, a reader that blocks goes offline so it does
+ * not hold back the writers. A writer publishes the new data, waits
+ * for every online reader to see a newer period and then frees the
+ * old data, that no reader can reach anymore.
+ */
+typedef struct rcu_reader_s {
+    _Atomic uint64_t period;    /* The last period seen or RCU_OFFLINE */
+    struct rcu_reader_s *next;
+} rcu_reader_t;
+
+typedef struct rcu_s {
+    _Atomic uint64_t period;    /* The current grace period, starts at 1 */
+
+    pthread_mutex_t lock;       /* Guards the list of readers and serializes the writers */
+    rcu_reader_t *readers;
+} rcu_t;
+
+rcu_t*          create_rcu      (void);
+void            free_rcu        (rcu_t **__restrict__ rcu);
+void            rcu_register    (rcu_t *__restrict__ rcu, rcu_reader_t *__restrict__ reader);
+void            rcu_unregister  (rcu_t *__restrict__ rcu, rcu_reader_t *__restrict__ reader);
+void            rcu_synchronize (rcu_t *__restrict__ rcu);
+
+/**
+ * @brief Announces that the reader holds no reference to the shared data.
+ *
+ * @param rcu the RCU domain
+ * @param reader the reader of the calling thread
+ */
+static inline void rcu_quiescent(rcu_t *__restrict__ rcu, rcu_reader_t *__restrict__ reader) {
+    atomic_store(&reader->period, atomic_load_explicit(&rcu->period, memory_order_relaxed));
+}
+
+/**
+ * @brief Takes the reader out of the grace periods, the reader must not
+ * use the shared data until it comes back online.
+ *
+ * @param reader the reader of the calling thread
+ */
+static inline void rcu_offline(rcu_reader_t *__restrict__ reader) {
+    atomic_store(&reader->period, RCU_OFFLINE);
+}
+
+/**
+ * @brief Brings the reader back into the grace periods.
+ *
+ * @param rcu the RCU domain
+ * @param reader the reader of the calling thread
+ */
+static inline void rcu_online(rcu_t *__restrict__ rcu, rcu_reader_t *__restrict__ reader) {
+    rcu_quiescent(rcu, reader);
+}
+
+#endif /* RCU_H_ */
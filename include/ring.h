@@ -0,0 +1,133 @@
+#ifndef RING_H_
+#define RING_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sched.h>
+
+#define RING_CACHE_LINE 64u
+#define RING_MAX_SIZE (1u << 24)
+
+#define RING_SINGLE_PRODUCER 0      /* Just one thread enqueues */
+#define RING_MULTI_PRODUCER 1       /* Any thread enqueues */
+
+/*
+ * A bounded queue of pointers with a single consumer and one or more
+ * producers, without locks. The slots are a power of two and the
+ * indexes run freely, so the used slots are just tail - head. The
+ * producer and the consumer indexes live on their own cache lines,
+ * so the two sides do not bounce a line for every element.
+ *
+ * The producers of a multi-producer ring first reserve their slots by
+ * moving the producer head, copy the elements and then publish them
+ * in the order they were reserved by moving the producer tail.
+ */
+typedef struct ring_s {
+    uint32_t mask;              /* The number of slots - 1 */
+    uint32_t size;              /* The number of slots */
+    int flags;                  /* RING_SINGLE_PRODUCER or RING_MULTI_PRODUCER */
+
+    struct {
+        _Atomic uint32_t head;  /* The next slot reserved by a producer */
+        _Atomic uint32_t tail;  /* The slots before it can be read */
+    } prod __attribute__((aligned(RING_CACHE_LINE)));
+
+    struct {
+        _Atomic uint32_t tail;  /* The slots before it can be written again */
+    } cons __attribute__((aligned(RING_CACHE_LINE)));
+
+    void *slots[] __attribute__((aligned(RING_CACHE_LINE)));
+} ring_t;
+
+ring_t*         create_ring     (uint32_t count, int flags);
+void            free_ring       (ring_t **__restrict__ ring);
+
+/**
+ * @brief Returns the elements stored in the ring. Another thread may
+ * change it right away, so it is exact just for the consumer, which
+ * may get more elements, and a single producer, which may have more
+ * room.
+ *
+ * @param ring the ring
+ * @return uint32_t the number of elements.
+ */
+static inline uint32_t ring_count(const ring_t *__restrict__ ring) {
+    return atomic_load_explicit(&ring->prod.tail, memory_order_acquire) -
+           atomic_load_explicit(&ring->cons.tail, memory_order_acquire);
+}
+
+/**
+ * @brief Adds up to count elements at the end of the ring, the
+ * elements that do not fit are not added.
+ *
+ * @param ring the ring
+ * @param objs the elements to add, in order
+ * @param count the number of elements
+ * @return uint32_t the number of elements added, the first ones of objs.
+ */
+static inline uint32_t ring_enqueue_burst(ring_t *__restrict__ ring, void *const *objs, uint32_t count) {
+    uint32_t head = atomic_load_explicit(&ring->prod.head, memory_order_relaxed);
+    uint32_t room;
+
+    do {
+        room = ring->size - (head - atomic_load_explicit(&ring->cons.tail, memory_order_acquire));
+
+        if (count > room) {
+            count = room;
+        }
+
+        if (count == 0) {
+            return 0;
+        }
+
+        if (ring->flags != RING_MULTI_PRODUCER) {
+            atomic_store_explicit(&ring->prod.head, head + count, memory_order_relaxed);
+            break;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&ring->prod.head, &head, head + count,
+                                                    memory_order_relaxed, memory_order_relaxed));
+
+    for (uint32_t iter = 0; iter < count; ++iter) {
+        ring->slots[(head + iter) & ring->mask] = objs[iter];
+    }
+
+    /* The producers that reserved slots before this one publish first */
+    while (atomic_load_explicit(&ring->prod.tail, memory_order_acquire) != head) {
+        sched_yield();
+    }
+
+    atomic_store_explicit(&ring->prod.tail, head + count, memory_order_release);
+
+    return count;
+}
+
+/**
+ * @brief Removes up to count elements from the front of the ring,
+ * just a single thread may call it.
+ *
+ * @param ring the ring
+ * @param objs receives the elements, in order
+ * @param count the most elements to remove
+ * @return uint32_t the number of elements removed.
+ */
+static inline uint32_t ring_dequeue_burst(ring_t *__restrict__ ring, void **objs, uint32_t count) {
+    uint32_t tail = atomic_load_explicit(&ring->cons.tail, memory_order_relaxed);
+    uint32_t used = atomic_load_explicit(&ring->prod.tail, memory_order_acquire) - tail;
+
+    if (count > used) {
+        count = used;
+    }
+
+    for (uint32_t iter = 0; iter < count; ++iter) {
+        objs[iter] = ring->slots[(tail + iter) & ring->mask];
+    }
+
+    atomic_store_explicit(&ring->cons.tail, tail + count, memory_order_release);
+
+    return count;
+}
+
+#endif /* RING_H_ */
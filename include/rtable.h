@@ -0,0 +1,30 @@
+#ifndef RTABLE_H_
+#define RTABLE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "lib.h"
+
+#define RTABLE_MAX_THREADS 16u
+#define RTABLE_CHUNK_SIZE (1u << 20)    /* Smallest part of the file worth a thread */
+
+/*
+ * The routes of a text routing table in the order of the file.
+ * Every line holds "prefix next_hop mask interface", the addresses
+ * as dotted quads, and the lines that do not follow it are skipped.
+ */
+typedef struct rtable_s {
+    struct route_table_entry *routes;
+    size_t len;
+
+    size_t errors;              /* Number of malformed lines */
+} rtable_t;
+
+rtable_t*       rtable_parse    (const char *filename, unsigned int threads);
+int             rtable_parse_route  (const char *iter, const char *end, struct route_table_entry *route);
+void            free_rtable     (rtable_t **__restrict__ table);
+
+#endif /* RTABLE_H_ */
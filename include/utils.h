@@ -6,12 +6,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 
 #include "queue.h"
 #include "lib.h"
 #include "protocols.h"
 #include "binary_trie.h"
-#include "vector.h"
+#include "fib.h"
+#include "fib_reload.h"
+#include "control.h"
+#include "rcu.h"
+#include "arp_cache.h"
+#include "adjacency.h"
+#include "packet_pool.h"
+#include "ring.h"
+#include "csum.h"
 
 #define IP_TYPE htons(0x0800)
 #define ARP_TYPE htons(0x0806)
@@ -26,46 +35,123 @@
 #define ICMP_TIME_EXCED (uint8_t)11
 #define ICMP_DEST_UNREACH (uint8_t)3
 
+#define PUNT_RING_SIZE 1024u
+
+/* Why a packet left the fast path for the slow path thread */
+typedef enum punt_reason_s {
+	PUNT_ARP,								/* An ARP request or replay */
+	PUNT_ECHO,								/* A packet for the router, answered with an ICMP Response */
+	PUNT_UNREACH,							/* No route, answered with an ICMP Host Unreachable */
+	PUNT_TTL,								/* The packet lived enough, answered with an ICMP Time Excedded */
+	PUNT_RESOLVE							/* The MAC address of the next hop is not REACHABLE */
+} punt_reason_t;
+
+/*
+ * A packet buffer taken from the packet pool. The router receives
+ * into its current buffer and hands the whole buffer to the slow path
+ * and then to the queue of a next hop on an ARP miss, so a punted or
+ * a waiting packet is never copied.
+ */
 typedef struct packed_msg_s {
-	char *buf;
+	arp_pending_t node;						/* Links the packets that wait for the same next hop, must stay first */
 	size_t len;
 	int interface;
 	uint32_t hop;
+	punt_reason_t punt;
+	char buf[MAX_PACKET_LEN] __attribute__((aligned(PACKET_POOL_ALIGN)));
 } packed_msg_t;
 
+typedef struct router_config_s {
+	char *rtable;							/* The routing table file, text or compiled */
+	const char *engine;						/* The engine used for the longest prefix match */
+	const char *control_path;				/* The path of the control socket or NULL for none */
+	uint32_t arp_capacity;					/* The most MAC addresses kept in the cache */
+	uint32_t packets;						/* The packet buffers, the bursts of the workers and the ones waiting for ARP */
+	uint32_t workers;						/* The forwarding threads */
+	int backend;							/* IO_BACKEND_SOCKET or IO_BACKEND_RING */
+} router_config_t;
+
+typedef struct worker_s worker_t;
+
+/*
+ * The state shared by the forwarding threads. The routing table is
+ * read without a lock and replaced through RCU, the neighbors and the
+ * packet buffers are changed under the neighbor lock. The workers just
+ * forward, every other packet is punted to the slow path thread, which
+ * answers ARP and ICMP, resolves the next hops and ages the ARP cache.
+ */
 typedef struct router_s {
-	btrie_t *routes;						/* The Trie structure storing the routing table */
-	vector_t *macs;							/* Cache memory in order to store the MAC addressed from ARP Replay */
-	queue pckg_queue;						/* A queue with packets that are waiting for an ARP Replay */
-	queue pckg_aux;							/* A queue that helps forwarding the packets that got the MAC address */
+	fib_t *_Atomic routes;					/* The routing table and the engine used for matching */
+	pthread_mutex_t routes_lock;			/* Serializes the threads that replace or update the routing table */
+	rcu_t *rcu;								/* Delays freeing a replaced routing table until no packet uses it */
+	fib_reload_t *reload;					/* Rebuilds the routing table when its file changes */
+	control_t *control;						/* Serves the route updates and queries of the control socket */
+	atomic_int flush_arp;					/* Set by the control socket to drop the MAC addresses cache */
+
+	pthread_mutex_t neigh_lock;				/* Guards the ARP cache, the packet pool and the aging time */
+	arp_cache_t *macs;						/* The neighbors of the router and their MAC addresses */
+	uint64_t arp_aged;						/* When the ARP cache was last aged, in milliseconds */
+	adj_table_t *adjs;						/* The Ethernet headers of the REACHABLE next hops, changed by the slow path */
+	packet_pool_t *packets;					/* The packet buffers of the bursts, of the punted and of the waiting packets */
+
+	ring_t *punt;							/* The packets the workers hand to the slow path */
+	int punt_fd;							/* Wakes up the slow path when packets were punted */
+	atomic_int slow_stop;					/* Asks the slow path thread to stop */
+	worker_t *slow;							/* The context of the slow path thread */
+
+	worker_t *workers;						/* The forwarding threads */
+	uint32_t workers_len;
+
+	void (*ipv4)(worker_t *this);			/* The handler function for IPv4 packets */
+	void (*arp)(worker_t *this);			/* The handler function for ARP packets */
+} router_t;
+
+/*
+ * A forwarding thread and the packet it handles. Every worker receives
+ * from its own sockets, so it owns its burst buffers until it hands one
+ * to the queue of a next hop.
+ */
+struct worker_s {
+	router_t *router;						/* The state shared with the other workers */
+	pthread_t thread;
+	uint32_t id;
+	rcu_reader_t reader;					/* The worker as a reader of the routing table */
 
 	struct ether_header *eth_hdr;			/* The Ethernet Header that coresponds to the current sending packet */
 	struct iphdr *ip_hdr;					/* The IP Header that coresponds to the current sending packet (Optional) */
 	struct arp_header *arp_hdr;				/* The ARP Header that coresponds to the current sending packet (Optional) */
 	struct icmphdr *icmp_hdr;				/* The ICMP Header that coresponds to the current sending packet (Optional) */
 
-	char buf[MAX_PACKET_LEN];				/* The current packet buffer */
+	packed_msg_t *burst[BURST_SIZE];		/* The buffers that receive a burst of packets */
+	struct frame frames[BURST_SIZE];		/* The lengths and the interfaces of the received burst */
+	hop_info_t routes[BURST_SIZE];			/* The routes of the IPv4 packets of the burst, matched together */
+	int burst_len;							/* The packets received in the current burst */
+	int burst_index;						/* The current packet of the burst */
+	packed_msg_t *pckg;						/* The buffer of the current packet */
+	char *buf;								/* The current packet buffer, the data of pckg */
 	size_t len;								/* Length of the buffer that was read from the network */
 
-	void (*ipv4)(struct router_s *this);	/* The handler function for IPv4 packets */
-	void (*arp)(struct router_s *this);		/* The handler function for ARP packets */
-
 	uint32_t next_hop;						/* The best hop chosen for the forwarding the packet */
 	int interface;							/* The interface that the packet was received or the interface that the packet will be sent */
-} router_t;
+	int punted;								/* Packets punted since the slow path was woken up */
+	packed_msg_t *spare;					/* A fresh buffer left over by a punt that found the ring full */
+};
 
 #define DEBUG(MSG) \
 	do { \
 		fprintf(stderr, "%s\n", MSG); \
 	} while (0)
 
-router_t* 	init_router			(char *path);
+router_t* 	init_router			(const router_config_t *config);
 void 		free_router			(router_t *router);
+void 		start_worker		(worker_t *worker);
 
-uint8_t 	packet_is_ipv4		(router_t *router);
-uint8_t 	packet_is_arp		(router_t *router);
+uint8_t 	packet_is_ipv4		(worker_t *worker);
+uint8_t 	packet_is_arp		(worker_t *worker);
 
-int 		recv_msg			(router_t *router);
-void 		init_msg_fields		(router_t *router);
+int 		recv_msgs			(worker_t *worker);
+void 		lookup_msgs			(worker_t *worker);
+void 		init_msg_fields		(worker_t *worker, int index);
+void 		send_msgs			(worker_t *worker);
 
 #endif /* UTILS_H_ */
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include "adjacency.h"
+
+/**
+ * @brief Create an adjacency table object.
+ *
+ * @param capacity the most next hops stored at once
+ * @return adj_table_t* returns an empty table or NULL on failure.
+ */
+adj_table_t* create_adj_table(uint32_t capacity) {
+    if ((capacity == 0) || (capacity > ADJ_MAX_CAPACITY)) {
+        return NULL;
+    }
+
+    adj_table_t *new_table = malloc(sizeof *new_table);
+
+    if (new_table != NULL) {
+        uint32_t slots = 8;
+
+        /* A quarter of the slots stays free to end the probe sequences */
+        while (slots - (slots >> 2) < capacity) {
+            slots <<= 1;
+        }
+
+        new_table->entries = calloc(slots, sizeof *new_table->entries);
+
+        if (new_table->entries == NULL) {
+            free(new_table);
+            return NULL;
+        }
+
+        atomic_init(&new_table->seq, 0);
+        new_table->mask = slots - 1;
+        new_table->len = 0;
+        new_table->capacity = capacity;
+    }
+
+    return new_table;
+}
+
+/**
+ * @brief Frees the memory allocated for the table.
+ *
+ * @param table a pointer to the adjacency table.
+ */
+void free_adj_table(adj_table_t **__restrict__ table) {
+    if ((table != NULL) && (*table != NULL)) {
+        free((*table)->entries);
+
+        free(*table);
+        *table = NULL;
+    }
+}
+
+static void adj_table_write_begin(adj_table_t *__restrict__ table) {
+    atomic_fetch_add_explicit(&table->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void adj_table_write_end(adj_table_t *__restrict__ table) {
+    atomic_fetch_add_explicit(&table->seq, 1, memory_order_release);
+}
+
+static adj_entry_t* adj_table_find(const adj_table_t *__restrict__ table, uint32_t ip) {
+    for (uint32_t slot = adj_table_slot(table, ip); table->entries[slot].used != 0; slot = (slot + 1) & table->mask) {
+        if (table->entries[slot].ip == ip) {
+            return table->entries + slot;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Builds the Ethernet header of the frames sent to a next hop,
+ * a next hop that is already stored gets the new header in place.
+ *
+ * @param table the adjacency table
+ * @param ip the next hop in network order
+ * @param interface the interface the frames leave on
+ * @param dst the MAC address of the next hop
+ * @param src the MAC address of the interface
+ * @param ethertype the type of the frames in network order
+ * @param expires when the header stops being used, in milliseconds
+ * @return int 0 on success or -1 on failure.
+ */
+int adj_table_set(adj_table_t *__restrict__ table, uint32_t ip, int interface, const uint8_t *dst,
+                  const uint8_t *src, uint16_t ethertype, uint64_t expires) {
+    if ((table == NULL) || (dst == NULL) || (src == NULL)) {
+        return -1;
+    }
+
+    adj_entry_t *entry = adj_table_find(table, ip);
+
+    /* The next hops that expired are dropped together when there is no room for a new one */
+    if ((entry == NULL) && (table->len == table->capacity)) {
+        adj_table_flush(table);
+    }
+
+    adj_table_write_begin(table);
+
+    if (entry == NULL) {
+        uint32_t slot = adj_table_slot(table, ip);
+
+        while (table->entries[slot].used != 0) {
+            slot = (slot + 1) & table->mask;
+        }
+
+        entry = table->entries + slot;
+        entry->ip = ip;
+        entry->used = 1;
+        ++(table->len);
+    }
+
+    entry->interface = interface;
+    entry->expires = expires;
+
+    memcpy(entry->rewrite, dst, ADJ_MAC_SIZE);
+    memcpy(entry->rewrite + ADJ_MAC_SIZE, src, ADJ_MAC_SIZE);
+    memcpy(entry->rewrite + 2 * ADJ_MAC_SIZE, &ethertype, sizeof ethertype);
+
+    adj_table_write_end(table);
+
+    return 0;
+}
+
+/**
+ * @brief Stops using the header of a next hop, the next packet for it
+ * is resolved again.
+ *
+ * @param table the adjacency table
+ * @param ip the next hop in network order
+ */
+void adj_table_expire(adj_table_t *__restrict__ table, uint32_t ip) {
+    if (table != NULL) {
+        adj_entry_t *entry = adj_table_find(table, ip);
+
+        if (entry != NULL) {
+            adj_table_write_begin(table);
+            entry->expires = 0;
+            adj_table_write_end(table);
+        }
+    }
+}
+
+/**
+ * @brief Drops every next hop stored in the table.
+ *
+ * @param table the adjacency table
+ */
+void adj_table_flush(adj_table_t *__restrict__ table) {
+    if (table != NULL) {
+        adj_table_write_begin(table);
+
+        memset(table->entries, 0, sizeof *table->entries * (table->mask + 1));
+        table->len = 0;
+
+        adj_table_write_end(table);
+    }
+}
@@ -0,0 +1,365 @@
+#include "arp_cache.h"
+
+/**
+ * @brief Create an arp cache object.
+ *
+ * @param capacity the most addresses stored at once
+ * @param drop frees the waiting packets that are dropped, NULL if they are not freed
+ * @param drop_arg opaque argument passed to the drop function
+ * @return arp_cache_t* returns an empty cache or NULL on failure.
+ */
+arp_cache_t* create_arp_cache(uint32_t capacity, arp_drop_fn drop, void *drop_arg) {
+    if ((capacity == 0) || (capacity > ARP_CACHE_MAX_CAPACITY)) {
+        return NULL;
+    }
+
+    arp_cache_t *new_cache = malloc(sizeof *new_cache);
+
+    if (new_cache != NULL) {
+        uint32_t slots = 8;
+
+        /* A quarter of the slots stays free to end the probe sequences */
+        while (slots - (slots >> 2) < capacity) {
+            slots <<= 1;
+        }
+
+        new_cache->entries = calloc(slots, sizeof *new_cache->entries);
+
+        if (new_cache->entries == NULL) {
+            free(new_cache);
+            return NULL;
+        }
+
+        new_cache->mask = slots - 1;
+        new_cache->len = 0;
+        new_cache->capacity = capacity;
+        new_cache->drop = drop;
+        new_cache->drop_arg = drop_arg;
+    }
+
+    return new_cache;
+}
+
+/**
+ * @brief Frees the memory allocated for the cache.
+ *
+ * @param cache a pointer to the ARP cache.
+ */
+void free_arp_cache(arp_cache_t **__restrict__ cache) {
+    if ((cache != NULL) && (*cache != NULL)) {
+        arp_cache_flush(*cache);
+        free((*cache)->entries);
+
+        free(*cache);
+        *cache = NULL;
+    }
+}
+
+static void arp_cache_drop(const arp_cache_t *__restrict__ cache, arp_pending_t *pending) {
+    while (pending != NULL) {
+        arp_pending_t *next = pending->next;
+
+        if (cache->drop != NULL) {
+            cache->drop(pending, cache->drop_arg);
+        }
+
+        pending = next;
+    }
+}
+
+static arp_cache_entry_t* arp_cache_insert(arp_cache_t *__restrict__ cache, uint32_t ip) {
+    uint32_t slot = arp_cache_slot(cache, ip);
+
+    while ((cache->entries[slot].state != ARP_FREE) && (cache->entries[slot].ip != ip)) {
+        slot = (slot + 1) & cache->mask;
+    }
+
+    if (cache->entries[slot].state == ARP_FREE) {
+        if (cache->len == cache->capacity) {
+            return NULL;
+        }
+
+        cache->entries[slot].ip = ip;
+        ++(cache->len);
+    }
+
+    return cache->entries + slot;
+}
+
+/**
+ * @brief Decides what happens to a packet sent to a neighbor. An
+ * unknown neighbor gets an INCOMPLETE entry and a single request is
+ * sent for it, the following packets just wait for the reply.
+ *
+ * @param cache the ARP cache
+ * @param ip the address of the neighbor in network order
+ * @param interface the interface that leads to the neighbor
+ * @param now the current time in milliseconds
+ * @param mac receives the MAC address when the packet can be sent
+ * @return arp_action_t the action for the packet.
+ */
+arp_action_t arp_cache_resolve(arp_cache_t *__restrict__ cache, uint32_t ip, int interface, uint64_t now,
+                               const uint8_t **mac) {
+    arp_cache_entry_t *entry = arp_cache_find(cache, ip);
+
+    if (entry == NULL) {
+        entry = arp_cache_insert(cache, ip);
+
+        if (entry == NULL) {
+            return ARP_DROP;
+        }
+
+        entry->state = ARP_INCOMPLETE;
+        entry->interface = interface;
+        entry->probes = 1;
+        entry->probed = now;
+
+        return ARP_QUEUE_REQUEST;
+    }
+
+    if (entry->state == ARP_INCOMPLETE) {
+        return ARP_QUEUE;
+    }
+
+    *mac = entry->mac;
+
+    /* A stale address is confirmed at most once per retry interval */
+    if ((entry->state == ARP_STALE) && (now - entry->probed >= ARP_RETRY_MS)) {
+        entry->interface = interface;
+        entry->probed = now;
+        ++(entry->probes);
+
+        return ARP_SEND_PROBE;
+    }
+
+    return ARP_SEND;
+}
+
+/**
+ * @brief Stores the MAC address of a neighbor, an address that is
+ * already cached gets the new MAC address in place. A REACHABLE entry
+ * that is learned again as STALE with the same MAC address stays
+ * REACHABLE.
+ *
+ * @param cache the ARP cache
+ * @param ip the address in network order
+ * @param mac the MAC address
+ * @param state ARP_REACHABLE for a reply or ARP_STALE for an address learned otherwise
+ * @param now the current time in milliseconds
+ * @param create 0 to update just the addresses that are already cached
+ * @return int 0 on success or -1 if the address was not stored.
+ */
+int arp_cache_update(arp_cache_t *__restrict__ cache, uint32_t ip, const uint8_t *mac,
+                     arp_state_t state, uint64_t now, int create) {
+    if ((cache == NULL) || (mac == NULL)) {
+        return -1;
+    }
+
+    arp_cache_entry_t *entry = arp_cache_find(cache, ip);
+
+    if ((entry == NULL) && (create != 0)) {
+        entry = arp_cache_insert(cache, ip);
+
+        if (entry != NULL) {
+            entry->state = ARP_FREE;
+        }
+    }
+
+    if (entry == NULL) {
+        return -1;
+    }
+
+    if ((state == ARP_STALE) && (entry->state == ARP_REACHABLE) && (memcmp(entry->mac, mac, MAC_ADDR_SIZE) == 0)) {
+        return 0;
+    }
+
+    memcpy(entry->mac, mac, MAC_ADDR_SIZE);
+    entry->state = state;
+    entry->probes = 0;
+    entry->confirmed = now;
+
+    /* A stale entry is confirmed by the next packet that uses it */
+    entry->probed = (state == ARP_STALE) ? (now - ARP_RETRY_MS) : now;
+
+    return 0;
+}
+
+/**
+ * @brief Queues a packet until the MAC address of its next hop is
+ * known. The queue of a neighbor is capped, the oldest packet is
+ * dropped to make room for a new one.
+ *
+ * @param cache the ARP cache
+ * @param ip the address of the next hop in network order
+ * @param packet the packet, owned by the cache from now on
+ * @return int 0 if the packet was queued or -1 if the neighbor is not cached.
+ */
+int arp_cache_enqueue(arp_cache_t *__restrict__ cache, uint32_t ip, arp_pending_t *packet) {
+    if ((cache == NULL) || (packet == NULL)) {
+        return -1;
+    }
+
+    arp_cache_entry_t *entry = arp_cache_find(cache, ip);
+
+    if (entry == NULL) {
+        return -1;
+    }
+
+    packet->next = NULL;
+
+    if (entry->pending == NULL) {
+        entry->pending = packet;
+    } else {
+        entry->pending_tail->next = packet;
+    }
+
+    entry->pending_tail = packet;
+
+    if (++(entry->pending_len) > ARP_PENDING_MAX) {
+        arp_pending_t *oldest = entry->pending;
+
+        entry->pending = oldest->next;
+        --(entry->pending_len);
+
+        oldest->next = NULL;
+        arp_cache_drop(cache, oldest);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Takes the packets that wait for the MAC address of a neighbor.
+ *
+ * @param cache the ARP cache
+ * @param ip the address of the neighbor in network order
+ * @return arp_pending_t* the packets, oldest first, owned by the caller or NULL if none wait.
+ */
+arp_pending_t* arp_cache_take(arp_cache_t *__restrict__ cache, uint32_t ip) {
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    arp_cache_entry_t *entry = arp_cache_find(cache, ip);
+
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    arp_pending_t *pending = entry->pending;
+
+    entry->pending = NULL;
+    entry->pending_tail = NULL;
+    entry->pending_len = 0;
+
+    return pending;
+}
+
+/**
+ * @brief Drops the MAC address of an IPv4 address and the packets
+ * that wait for it.
+ *
+ * @param cache the ARP cache
+ * @param ip the address in network order
+ * @return int 0 if the address was dropped or -1 if it was not cached.
+ */
+int arp_cache_remove(arp_cache_t *__restrict__ cache, uint32_t ip) {
+    if (cache == NULL) {
+        return -1;
+    }
+
+    uint32_t slot = arp_cache_slot(cache, ip);
+
+    while ((cache->entries[slot].state != ARP_FREE) && (cache->entries[slot].ip != ip)) {
+        slot = (slot + 1) & cache->mask;
+    }
+
+    if (cache->entries[slot].state == ARP_FREE) {
+        return -1;
+    }
+
+    arp_cache_drop(cache, cache->entries[slot].pending);
+
+    /* Move back the entries that probed over the freed slot */
+    uint32_t hole = slot;
+
+    for (uint32_t next = (hole + 1) & cache->mask; cache->entries[next].state != ARP_FREE; next = (next + 1) & cache->mask) {
+        uint32_t home = arp_cache_slot(cache, cache->entries[next].ip);
+
+        /* An entry stays if its home slot lies cyclically in (hole, next] */
+        if (((next - home) & cache->mask) >= ((next - hole) & cache->mask)) {
+            cache->entries[hole] = cache->entries[next];
+            hole = next;
+        }
+    }
+
+    memset(cache->entries + hole, 0, sizeof *cache->entries);
+    --(cache->len);
+
+    return 0;
+}
+
+/**
+ * @brief Ages the entries of the cache. A REACHABLE entry becomes STALE
+ * after a while and a STALE entry that is not confirmed is dropped,
+ * the requests of an INCOMPLETE entry are sent again a few times
+ * before the neighbor and its packets are dropped.
+ *
+ * @param cache the ARP cache
+ * @param now the current time in milliseconds
+ * @param fn receives the requests to send and the dropped neighbors
+ * @param arg opaque argument passed to the callback
+ */
+void arp_cache_age(arp_cache_t *__restrict__ cache, uint64_t now, arp_cache_fn fn, void *arg) {
+    if (cache == NULL) {
+        return;
+    }
+
+    for (uint32_t slot = 0; slot <= cache->mask; ++slot) {
+        arp_cache_entry_t *entry = cache->entries + slot;
+        int expired = 0;
+
+        if ((entry->state == ARP_REACHABLE) && (now - entry->confirmed >= ARP_REACHABLE_MS)) {
+            entry->state = ARP_STALE;
+        } else if ((entry->state == ARP_STALE) && (now - entry->confirmed >= ARP_REACHABLE_MS + ARP_STALE_MS)) {
+            expired = 1;
+        } else if ((entry->state == ARP_INCOMPLETE) && (now - entry->probed >= ARP_RETRY_MS)) {
+            if (entry->probes < ARP_MAX_PROBES) {
+                entry->probed = now;
+                ++(entry->probes);
+
+                if (fn != NULL) {
+                    fn(entry->ip, entry->interface, ARP_RETRY, arg);
+                }
+            } else {
+                expired = 1;
+
+                if (fn != NULL) {
+                    fn(entry->ip, entry->interface, ARP_FAILED, arg);
+                }
+            }
+        }
+
+        /* The removal moves a later entry into this slot, so the slot is checked again */
+        if ((expired != 0) && (arp_cache_remove(cache, entry->ip) == 0)) {
+            --slot;
+        }
+    }
+}
+
+/**
+ * @brief Drops every neighbor stored in the cache and the packets
+ * that wait for them.
+ *
+ * @param cache the ARP cache
+ */
+void arp_cache_flush(arp_cache_t *__restrict__ cache) {
+    if (cache != NULL) {
+        for (uint32_t slot = 0; slot <= cache->mask; ++slot) {
+            arp_cache_drop(cache, cache->entries[slot].pending);
+        }
+
+        memset(cache->entries, 0, sizeof *cache->entries * (cache->mask + 1));
+        cache->len = 0;
+    }
+}
@@ -1,23 +1,44 @@
 #include "binary_trie.h"
+#include "rtable.h"
+
+#include <arpa/inet.h>
+#include <sys/mman.h>
 
 /**
- * @brief Create a btrie node object
+ * @brief Takes a new empty node from the arena of the trie, the nodes
+ * released by the deletions are reused first and the arena doubles
+ * its size when it is full.
  * 
- * @return btrie_node_t* returns an empty binary trie node.
+ * @return uint32_t returns the index of the new node or BTRIE_NIL on failure.
  */
-static btrie_node_t* create_btrie_node(void) {
-    btrie_node_t *new_node = malloc(sizeof *new_node);
+static uint32_t create_btrie_node(btrie_t *__restrict__ tree) {
+    uint32_t node_idx = tree->nodes_free;
+
+    if (node_idx != BTRIE_NIL) {
+        tree->nodes_free = tree->nodes[node_idx].left;
+    } else {
+        if (tree->nodes_len == tree->nodes_cap) {
+            uint32_t new_cap = (tree->nodes_cap == 0) ? BTRIE_INIT_NODES : (tree->nodes_cap << 1);
+            btrie_node_t *new_nodes = realloc(tree->nodes, sizeof *new_nodes * new_cap);
+
+            if ((new_cap <= tree->nodes_cap) || (new_nodes == NULL)) {
+                return BTRIE_NIL;
+            }
 
-    if (new_node != NULL) {
-        new_node->type = EMPTY;
-        new_node->hop = 0;
-        new_node->interface = -1;
+            tree->nodes = new_nodes;
+            tree->nodes_cap = new_cap;
+        }
 
-        new_node->left = NULL;
-        new_node->right = NULL;
+        node_idx = tree->nodes_len++;
     }
 
-    return new_node;
+    btrie_node_t *new_node = tree->nodes + node_idx;
+
+    new_node->left = BTRIE_NIL;
+    new_node->right = BTRIE_NIL;
+    new_node->info = BTRIE_EMPTY;
+
+    return node_idx;
 }
 
 /**
@@ -29,208 +50,589 @@ btrie_t* create_btrie(void) {
     btrie_t *new_tree = malloc(sizeof *new_tree);
 
     if (new_tree != NULL) {
-        new_tree->root = create_btrie_node();
+        new_tree->nodes = NULL;
+        new_tree->nodes_len = 0;
+        new_tree->nodes_cap = 0;
+
+        new_tree->hops = NULL;
+        new_tree->hops_len = 0;
+        new_tree->hops_cap = 0;
+
+        new_tree->nodes_free = BTRIE_NIL;
+        new_tree->hops_free = BTRIE_EMPTY;
 
-        if (new_tree->root == NULL) {
+        new_tree->size = 0;
+
+        new_tree->image = NULL;
+        new_tree->image_size = 0;
+
+        /* The root is a dummy node that always lives at index 0 */
+        create_btrie_node(new_tree);
+
+        if (new_tree->nodes == NULL) {
             free(new_tree);
             new_tree = NULL;
-        } else {
-            new_tree->root->type = DUMMY;
-            new_tree->size = 0;
         }
     }
 
     return new_tree;
 }
 
-static void free_btrie_nodes(btrie_node_t *__restrict__ bnode) {
-    if (bnode != NULL) {
-        free_btrie_nodes(bnode->left);
-        free_btrie_nodes(bnode->right);
-
-        free(bnode);
-    }
-}
-
 /**
- * @brief Frees the memory allocated for the tree.
+ * @brief Frees the memory allocated for the tree, the nodes
+ * are released at once together with their arena.
  * 
  * @param tree a pointer to the binary trie.
  */
 void free_btrie(btrie_t **__restrict__ tree) {
     if ((tree != NULL) && (*tree != NULL)) {
-        free_btrie_nodes((*tree)->root);
+        if ((*tree)->image != NULL) {
+            munmap((*tree)->image, (*tree)->image_size);
+        } else {
+            free((*tree)->nodes);
+            free((*tree)->hops);
+        }
 
         free(*tree);
         *tree = NULL;
     }
 }
 
-static void fill_btrie_node(btrie_node_t *__restrict__ bnode, uint32_t hop, int interface) {
-    if (bnode != NULL) {
-        bnode->type = INFO;
-        bnode->hop = hop;
-        bnode->interface = interface;
+/**
+ * @brief Moves the arrays of a trie loaded from a snapshot to the heap,
+ * the mapping is read-only so it has to be copied before any update.
+ * 
+ * @param tree the binary trie
+ * @return int 0 on success or -1 if the arrays could not be copied.
+ */
+int btrie_thaw(btrie_t *__restrict__ tree) {
+    if (tree == NULL) {
+        return -1;
+    }
+
+    if (tree->image == NULL) {
+        return 0;
+    }
+
+    btrie_node_t *new_nodes = malloc(sizeof *new_nodes * tree->nodes_len);
+    hop_info_t *new_hops = malloc(sizeof *new_hops * (tree->hops_len == 0 ? 1 : tree->hops_len));
+
+    if ((new_nodes == NULL) || (new_hops == NULL)) {
+        free(new_nodes);
+        free(new_hops);
+
+        return -1;
+    }
+
+    memcpy(new_nodes, tree->nodes, sizeof *new_nodes * tree->nodes_len);
+    memcpy(new_hops, tree->hops, sizeof *new_hops * tree->hops_len);
+
+    munmap(tree->image, tree->image_size);
+
+    tree->nodes = new_nodes;
+    tree->nodes_cap = tree->nodes_len;
+    tree->hops = new_hops;
+    tree->hops_cap = (tree->hops_len == 0) ? 1 : tree->hops_len;
+
+    tree->image = NULL;
+    tree->image_size = 0;
+
+    return 0;
+}
+
+/**
+ * @brief Copies a binary trie, the copy keeps its arrays on the heap
+ * even if the trie was loaded from a snapshot.
+ * 
+ * @param tree the binary trie
+ * @return btrie_t* an allocated copy of the trie or NULL on failure
+ */
+btrie_t* btrie_clone(const btrie_t *__restrict__ tree) {
+    if (tree == NULL) {
+        return NULL;
+    }
+
+    btrie_t *new_tree = malloc(sizeof *new_tree);
+
+    if (new_tree == NULL) {
+        return NULL;
+    }
+
+    *new_tree = *tree;
+
+    new_tree->nodes = malloc(sizeof *new_tree->nodes * tree->nodes_len);
+    new_tree->hops = malloc(sizeof *new_tree->hops * (tree->hops_len == 0 ? 1 : tree->hops_len));
+
+    if ((new_tree->nodes == NULL) || (new_tree->hops == NULL)) {
+        free(new_tree->nodes);
+        free(new_tree->hops);
+        free(new_tree);
+
+        return NULL;
+    }
+
+    memcpy(new_tree->nodes, tree->nodes, sizeof *new_tree->nodes * tree->nodes_len);
+    memcpy(new_tree->hops, tree->hops, sizeof *new_tree->hops * tree->hops_len);
+
+    new_tree->nodes_cap = tree->nodes_len;
+    new_tree->hops_cap = (tree->hops_len == 0) ? 1 : tree->hops_len;
+
+    new_tree->image = NULL;
+    new_tree->image_size = 0;
+
+    return new_tree;
+}
+
+static uint32_t create_btrie_hop(btrie_t *__restrict__ tree) {
+    uint32_t info = tree->hops_free;
+
+    /* A released slot keeps the next free slot in its hop field */
+    if (info != BTRIE_EMPTY) {
+        tree->hops_free = tree->hops[info - 1].hop;
+
+        return info;
+    }
+
+    if (tree->hops_len == tree->hops_cap) {
+        uint32_t new_cap = (tree->hops_cap == 0) ? BTRIE_INIT_NODES : (tree->hops_cap << 1);
+        hop_info_t *new_hops = realloc(tree->hops, sizeof *new_hops * new_cap);
+
+        if ((new_cap <= tree->hops_cap) || (new_hops == NULL)) {
+            return BTRIE_EMPTY;
+        }
+
+        tree->hops = new_hops;
+        tree->hops_cap = new_cap;
+    }
+
+    return ++(tree->hops_len);
+}
+
+static void free_btrie_hop(btrie_t *__restrict__ tree, uint32_t info) {
+    tree->hops[info - 1].hop = tree->hops_free;
+    tree->hops[info - 1].status = INVALID;
+
+    tree->hops_free = info;
+}
+
+/**
+ * @brief Walks the path of a prefix without creating nodes.
+ *
+ * @param path if not NULL receives the nodes from the root to the prefix
+ * @return uint32_t the node of the prefix or BTRIE_NIL if the path is missing.
+ */
+static uint32_t btrie_find(const btrie_t *__restrict__ tree, uint32_t prefix, uint32_t mask, uint32_t *__restrict__ path) {
+    uint32_t prefix_length = (uint32_t)__builtin_popcount(mask);
+    uint32_t iter_prefix = ntohl(prefix & mask);
+    uint32_t iter_node = BTRIE_ROOT;
+
+    for (uint32_t depth = 0; depth < prefix_length; ++depth) {
+        uint32_t next_bit = (iter_prefix >> 31);
+        iter_prefix <<= 1;
+
+        if (path != NULL) {
+            path[depth] = iter_node;
+        }
+
+        iter_node = (next_bit == 0) ? tree->nodes[iter_node].left : tree->nodes[iter_node].right;
+
+        if (iter_node == BTRIE_NIL) {
+            return BTRIE_NIL;
+        }
     }
+
+    return iter_node;
 }
 
 /**
- * @brief Inserts an entry into the binary trie
+ * @brief Inserts an entry into the binary trie, a prefix that is
+ * already in the trie gets the new next hop and is counted once.
  * 
  * @param tree the binary trie
  * @param prefix the prefix to insert in the trie
  * @param mask the mask of the prefix
  * @param hop the hop described by the prefix
  * @param interface the interface described by the prefix
+ * @return int 0 on success or -1 if the trie could not grow.
  */
-void btrie_insert(btrie_t *__restrict__ tree, uint32_t prefix, uint32_t mask, uint32_t hop, int interface) {
-    if (tree != NULL) {
-        uint32_t prefix_length = 0;
-        uint32_t iter_mask = 0;
-        iter_mask = mask;
-
-        /* Compute how much bits to insert in the trie */
-        while (iter_mask != 0) {
-            prefix_length += (iter_mask & 1);
-            iter_mask >>= 1;
-        }
-
-        /* Insert the number of bits that are covered by the mask in network order */
-        if (prefix_length != 0) {
-            
-            btrie_node_t *iter_node = tree->root;
-
-            uint32_t iter_prefix = 0;
-            iter_prefix = (prefix & mask);
-
-            while ((prefix_length--) != 0) {
-                uint32_t next_bit = (iter_prefix & 1);
-                iter_prefix >>= 1;
-
-                if (next_bit == 0) {
-                    if (iter_node->left == NULL) {
-                        iter_node->left = create_btrie_node();
-                    }
-
-                    iter_node = iter_node->left;
-                } else if (next_bit == 1) {
-                    if (iter_node->right == NULL) {
-                        iter_node->right = create_btrie_node();
-                    }
-
-                    iter_node = iter_node->right;
-                } else {
-                    return;
-                }
+int btrie_insert(btrie_t *__restrict__ tree, uint32_t prefix, uint32_t mask, uint32_t hop, int interface) {
+    if (btrie_thaw(tree) != 0) {
+        return -1;
+    }
+
+    uint32_t prefix_length = (uint32_t)__builtin_popcount(mask);
+
+    /* The root does not hold a route, so the empty prefix is not stored */
+    if (prefix_length == 0) {
+        return 0;
+    }
+
+    uint32_t iter_node = BTRIE_ROOT;
+
+    /* Walk the prefix from its most significant bit in host order */
+    uint32_t iter_prefix = ntohl(prefix & mask);
+
+    while ((prefix_length--) != 0) {
+        uint32_t next_bit = (iter_prefix >> 31);
+        iter_prefix <<= 1;
+
+        /* The arena may move while growing, so just indices are kept */
+        uint32_t child = (next_bit == 0) ? tree->nodes[iter_node].left : tree->nodes[iter_node].right;
+
+        if (child == BTRIE_NIL) {
+            child = create_btrie_node(tree);
+
+            if (child == BTRIE_NIL) {
+                return -1;
             }
 
-            fill_btrie_node(iter_node, hop, interface);
-            ++(tree->size);
+            if (next_bit == 0) {
+                tree->nodes[iter_node].left = child;
+            } else {
+                tree->nodes[iter_node].right = child;
+            }
         }
+
+        iter_node = child;
     }
+
+    if (tree->nodes[iter_node].info == BTRIE_EMPTY) {
+        uint32_t info = create_btrie_hop(tree);
+
+        if (info == BTRIE_EMPTY) {
+            return -1;
+        }
+
+        tree->nodes[iter_node].info = info;
+        ++(tree->size);
+    }
+
+    /* An existing route keeps its slot in the hop table */
+    hop_info_t *info = tree->hops + (tree->nodes[iter_node].info - 1);
+
+    info->hop = hop;
+    info->interface = interface;
+    info->status = VALID;
+
+    return 0;
 }
 
 /**
- * @brief Computes the longest prefix match.
+ * @brief Changes the next hop of a route that is already in the trie.
+ * 
+ * @param tree the binary trie
+ * @param prefix the prefix of the route
+ * @param mask the mask of the prefix
+ * @param hop the new hop of the route
+ * @param interface the new interface of the route
+ * @return int 0 if the route was updated or -1 if it does not exist.
+ */
+int btrie_replace(btrie_t *__restrict__ tree, uint32_t prefix, uint32_t mask, uint32_t hop, int interface) {
+    if ((tree == NULL) || (mask == 0)) {
+        return -1;
+    }
+
+    uint32_t node_idx = btrie_find(tree, prefix, mask, NULL);
+
+    if ((node_idx == BTRIE_NIL) || (tree->nodes[node_idx].info == BTRIE_EMPTY) || (btrie_thaw(tree) != 0)) {
+        return -1;
+    }
+
+    hop_info_t *info = tree->hops + (tree->nodes[node_idx].info - 1);
+
+    info->hop = hop;
+    info->interface = interface;
+
+    return 0;
+}
+
+/**
+ * @brief Withdraws a route from the binary trie. The slot of its next
+ * hop is released and the nodes left without a route or children are
+ * pruned from the prefix up to the root, both are reused by the
+ * following insertions.
+ * 
+ * @param tree the binary trie
+ * @param prefix the prefix to delete from the trie
+ * @param mask the mask of the prefix
+ * @return int 0 if the route was deleted or -1 if it does not exist.
+ */
+int btrie_delete(btrie_t *__restrict__ tree, uint32_t prefix, uint32_t mask) {
+    if ((tree == NULL) || (mask == 0)) {
+        return -1;
+    }
+
+    uint32_t path[32];
+    uint32_t depth = (uint32_t)__builtin_popcount(mask);
+    uint32_t node_idx = btrie_find(tree, prefix, mask, path);
+
+    if ((node_idx == BTRIE_NIL) || (tree->nodes[node_idx].info == BTRIE_EMPTY) || (btrie_thaw(tree) != 0)) {
+        return -1;
+    }
+
+    free_btrie_hop(tree, tree->nodes[node_idx].info);
+    tree->nodes[node_idx].info = BTRIE_EMPTY;
+    --(tree->size);
+
+    /* The root always stays, so the walk stops at the first level */
+    while ((depth != 0) && (tree->nodes[node_idx].info == BTRIE_EMPTY) &&
+           (tree->nodes[node_idx].left == BTRIE_NIL) && (tree->nodes[node_idx].right == BTRIE_NIL)) {
+        btrie_node_t *parent = tree->nodes + path[--depth];
+
+        if (parent->left == node_idx) {
+            parent->left = BTRIE_NIL;
+        } else {
+            parent->right = BTRIE_NIL;
+        }
+
+        tree->nodes[node_idx].left = tree->nodes_free;
+        tree->nodes_free = node_idx;
+
+        node_idx = path[depth];
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Finds the longest route that covers a prefix and is strictly
+ * shorter than it, the route that takes over when the prefix is deleted.
+ * 
+ * @param tree the binary trie
+ * @param prefix the covered prefix
+ * @param mask the mask of the covered prefix
+ * @param info caller storage that receives the next hop and interface
+ * @param cover_mask receives the mask of the covering route
+ * @return hop_status_t VALID if a covering route exists or INVALID otherwise.
+ */
+hop_status_t btrie_cover(const btrie_t *__restrict__ tree, uint32_t prefix, uint32_t mask,
+                         hop_info_t *__restrict__ info, uint32_t *__restrict__ cover_mask) {
+    if ((tree == NULL) || (info == NULL) || (cover_mask == NULL)) {
+        return INVALID;
+    }
+
+    uint32_t prefix_length = (uint32_t)__builtin_popcount(mask);
+    uint32_t iter_prefix = ntohl(prefix & mask);
+    uint32_t iter_node = BTRIE_ROOT;
+    uint32_t best_info = BTRIE_EMPTY;
+    uint32_t best_depth = 0;
+
+    /* The root is the node 0, so a missing child is checked only after a step */
+    for (uint32_t depth = 0; depth < prefix_length; ++depth) {
+        if (tree->nodes[iter_node].info != BTRIE_EMPTY) {
+            best_info = tree->nodes[iter_node].info;
+            best_depth = depth;
+        }
+
+        uint32_t next_bit = (iter_prefix >> 31);
+        iter_prefix <<= 1;
+
+        iter_node = (next_bit == 0) ? tree->nodes[iter_node].left : tree->nodes[iter_node].right;
+
+        if (iter_node == BTRIE_NIL) {
+            break;
+        }
+    }
+
+    if (best_info == BTRIE_EMPTY) {
+        info->status = INVALID;
+        return INVALID;
+    }
+
+    *info = tree->hops[best_info - 1];
+    *cover_mask = htonl((best_depth == 0) ? 0 : (0xffffffffu << (32 - best_depth)));
+
+    return VALID;
+}
+
+/**
+ * @brief Computes the longest prefix match without allocating
+ * memory, the result is written in the storage of the caller.
  * 
  * @param tree the binary trie containing all the prefixes
  * @param addr the address to match
- * @return hop_info_t* an allocated structure to extract the information about the prefix
+ * @param info caller storage that receives the next hop and interface
+ * @return hop_status_t VALID if a route was found or INVALID otherwise.
  */
-hop_info_t* btrie_lpm(btrie_t *__restrict tree, uint32_t addr) {
-    if ((tree == NULL) || (tree->root == NULL)) {
-        return NULL;
+hop_status_t btrie_lookup(const btrie_t *__restrict__ tree, uint32_t addr, hop_info_t *__restrict__ info) {
+    if ((tree == NULL) || (tree->nodes == NULL) || (info == NULL)) {
+        return INVALID;
+    }
+
+    const btrie_node_t *nodes = tree->nodes;
+    uint32_t iter_node = BTRIE_ROOT;
+    uint32_t best_info = BTRIE_EMPTY;
+
+    addr = ntohl(addr);
+
+    do {
+        if (nodes[iter_node].info != BTRIE_EMPTY) {
+            best_info = nodes[iter_node].info;
+        }
+
+        uint32_t next_bit = (addr >> 31);
+        addr <<= 1;
+
+        iter_node = (next_bit == 0) ? nodes[iter_node].left : nodes[iter_node].right;
+    } while (iter_node != BTRIE_NIL);
+
+    if (best_info == BTRIE_EMPTY) {
+        info->status = INVALID;
+        return INVALID;
+    }
+
+    *info = tree->hops[best_info - 1];
+
+    return VALID;
+}
+
+typedef struct btrie_batch_walk_s {
+    uint32_t node;              /* The next node to visit */
+    uint32_t addr;              /* The bits of the address that were not consumed yet */
+    uint32_t best;              /* The info of the longest prefix matched so far */
+    size_t idx;                 /* The position of the address in the batch */
+} btrie_batch_walk_t;
+
+static void btrie_batch_start(btrie_batch_walk_t *__restrict__ walk, const uint32_t *__restrict__ addrs, size_t idx) {
+    walk->node = BTRIE_ROOT;
+    walk->addr = ntohl(addrs[idx]);
+    walk->best = BTRIE_EMPTY;
+    walk->idx = idx;
+}
+
+/**
+ * @brief Computes the longest prefix match for a batch of addresses.
+ * Up to BTRIE_BATCH_WIDTH walks are interleaved, every walk takes one
+ * step and prefetches its next node, so by the time the walk is
+ * resumed the node is already in the cache. When a walk ends the
+ * next address of the batch takes its place.
+ * 
+ * @param tree the binary trie containing all the prefixes
+ * @param addrs the addresses to match
+ * @param infos caller storage that receives a result for every address
+ * @param count the number of addresses in the batch
+ */
+void btrie_lookup_batch(const btrie_t *__restrict__ tree, const uint32_t *__restrict__ addrs,
+                        hop_info_t *__restrict__ infos, size_t count) {
+    if ((tree == NULL) || (tree->nodes == NULL) || (addrs == NULL) || (infos == NULL)) {
+        return;
     }
 
-    hop_info_t *lpm_route = malloc(sizeof *lpm_route);
-    lpm_route->status = INVALID;
+    const btrie_node_t *nodes = tree->nodes;
+    btrie_batch_walk_t walks[BTRIE_BATCH_WIDTH];
+    size_t width = (count < BTRIE_BATCH_WIDTH) ? count : BTRIE_BATCH_WIDTH;
+    size_t active = width;
+    size_t next = width;
 
-    if (lpm_route != NULL) {
-        btrie_node_t *iter_node = tree->root;
+    for (size_t w = 0; w < width; ++w) {
+        btrie_batch_start(walks + w, addrs, w);
+    }
+
+    while (active != 0) {
+        for (size_t w = 0; w < width; ++w) {
+            btrie_batch_walk_t *walk = walks + w;
 
-        while (iter_node != NULL) {
-            if (iter_node->type == INFO) {
-                lpm_route->hop = iter_node->hop;
-                lpm_route->interface = iter_node->interface;
-                lpm_route->status = VALID;
+            if (walk->idx == count) {
+                continue;
             }
 
-            uint32_t next_bit = (addr & 1);
-            addr >>= 1;
+            const btrie_node_t *bnode = nodes + walk->node;
 
-            if (next_bit == 0) {
-                iter_node = iter_node->left;
-            } else if (next_bit == 1) {
-                iter_node = iter_node->right;
+            if (bnode->info != BTRIE_EMPTY) {
+                walk->best = bnode->info;
+            }
+
+            walk->node = ((walk->addr >> 31) == 0) ? bnode->left : bnode->right;
+            walk->addr <<= 1;
+
+            if (walk->node != BTRIE_NIL) {
+                __builtin_prefetch(nodes + walk->node);
+                continue;
+            }
+
+            /* The walk is over, store its result and start the next address */
+            if (walk->best == BTRIE_EMPTY) {
+                infos[walk->idx].status = INVALID;
             } else {
-                free(lpm_route);
-                lpm_route = NULL;
+                infos[walk->idx] = tree->hops[walk->best - 1];
+            }
 
-                break;
+            if (next < count) {
+                btrie_batch_start(walk, addrs, next++);
+            } else {
+                walk->idx = count;
+                --active;
             }
         }
+    }
+}
+
+static void btrie_walk_nodes(const btrie_t *__restrict__ tree, uint32_t node_idx, uint32_t prefix, uint32_t depth,
+                             btrie_walk_fn fn, void *arg) {
+    const btrie_node_t *bnode = tree->nodes + node_idx;
+
+    if (bnode->info != BTRIE_EMPTY) {
+        const hop_info_t *info = tree->hops + (bnode->info - 1);
+        uint32_t mask = (depth == 0) ? 0 : (0xffffffffu << (32 - depth));
+
+        fn(htonl(prefix), htonl(mask), info->hop, info->interface, arg);
+    }
+
+    if (depth < 32) {
+        if (bnode->left != BTRIE_NIL) {
+            btrie_walk_nodes(tree, bnode->left, prefix, depth + 1, fn, arg);
+        }
 
-        if (lpm_route->status == INVALID) {
-            free(lpm_route);
-            lpm_route = NULL;
+        if (bnode->right != BTRIE_NIL) {
+            btrie_walk_nodes(tree, bnode->right, prefix | (1u << (31 - depth)), depth + 1, fn, arg);
         }
     }
+}
 
-    return lpm_route;
+/**
+ * @brief Visits every route stored in the trie. The routes are
+ * visited in pre-order, so a prefix is always reported before
+ * the more specific prefixes that it covers.
+ * 
+ * @param tree the binary trie
+ * @param fn callback receiving the prefix and the mask in network order
+ * @param arg opaque argument passed to the callback
+ */
+void btrie_walk(const btrie_t *__restrict__ tree, btrie_walk_fn fn, void *arg) {
+    if ((tree != NULL) && (fn != NULL)) {
+        btrie_walk_nodes(tree, BTRIE_ROOT, 0, 0, fn, arg);
+    }
 }
 
 /**
  * @brief Reads a file of routes and parses them to the binary trie
  * 
  * @param filename the file to read the routes
- * @return btrie_t* an allocated completed binary trie
+ * @return btrie_t* an allocated completed binary trie or NULL if the file
+ * could not be read or the trie could not hold every route
  */
 btrie_t* btrie_rtable(const char *filename) {
-    if (filename == NULL) {
+    rtable_t *routes = rtable_parse(filename, 0);
+
+    if (routes == NULL) {
         return NULL;
     }
 
     btrie_t *ip_trie = create_btrie();
 
     if (ip_trie != NULL) {
-        FILE *fin = fopen(filename, "r");
+        for (size_t i = 0; i < routes->len; ++i) {
 
-        if (fin == NULL) {
-            free_btrie(&ip_trie);
-        } else {
-            char *byte;
-            char line[MAX_LINE_SIZE];
-
-            while (fgets(line, MAX_LINE_SIZE, fin) != NULL) {
-                uint32_t prefix = 0;
-                uint32_t next_hop = 0;
-                uint32_t mask = 0;
-                int interface = 0;
-
-                byte = strtok(line, " .");
-
-                int byte_idx = 0;
-                while (byte != NULL) {
-                    if (byte_idx < 4) {
-                        *(((unsigned char *)&prefix)  + byte_idx % 4) = (unsigned char)atoi(byte);
-                    } else if (byte_idx < 8) {
-                        *(((unsigned char *)&next_hop)  + byte_idx % 4) = (unsigned char)atoi(byte);
-                    } else if (byte_idx < 12) {
-                        *(((unsigned char *)&mask)  + byte_idx % 4) = (unsigned char)atoi(byte);
-                    } else if (byte_idx == 12) {
-                        interface = atoi(byte);
-                    }
-
-                    byte = strtok(NULL, " .");
-                    ++byte_idx;
-                }
-
-                btrie_insert(ip_trie, prefix, mask, next_hop, interface);
+            /* A partial table is never published, the caller keeps the routes it has */
+            if (btrie_insert(ip_trie, routes->routes[i].prefix, routes->routes[i].mask,
+                             routes->routes[i].next_hop, routes->routes[i].interface) != 0) {
+                free_btrie(&ip_trie);
+                break;
             }
-
-            fclose(fin);
         }
     }
 
+    free_rtable(&routes);
+
     return ip_trie;
-}
\ No newline at end of file
+}
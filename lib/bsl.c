@@ -0,0 +1,313 @@
+#include "bsl.h"
+
+#include <arpa/inet.h>
+
+/**
+ * @brief Frees the memory allocated for the hash tables.
+ *
+ * @param bsl a pointer to the binary search on lengths structure.
+ */
+void free_bsl(bsl_t **__restrict__ bsl) {
+    if ((bsl != NULL) && (*bsl != NULL)) {
+        for (uint32_t i = 0; i <= BSL_MAX_LENGTHS; ++i) {
+            free((*bsl)->tables[i].entries);
+        }
+
+        free((*bsl)->hops);
+
+        free(*bsl);
+        *bsl = NULL;
+    }
+}
+
+static inline uint32_t bsl_mask(uint32_t length) {
+    return (length == 0) ? 0 : (0xffffffffu << (32 - length));
+}
+
+static inline uint32_t bsl_hash(uint32_t key) {
+
+    /* The low bits of the prefixes are zeros, so all the bits are mixed in */
+    key ^= key >> 16;
+    key *= 0x45d9f3bu;
+    key ^= key >> 16;
+
+    return key;
+}
+
+static const bsl_entry_t* bsl_find(const bsl_table_t *__restrict__ table, uint32_t key) {
+    uint32_t idx = bsl_hash(key) & table->mask;
+
+    while (table->entries[idx].value != 0) {
+        if (table->entries[idx].key == key) {
+            return table->entries + idx;
+        }
+
+        idx = (idx + 1) & table->mask;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Computes the longest prefix match with a binary search over
+ * the prefix lengths, so at most log2(32) + 1 hash probes are done.
+ *
+ * @param bsl the hash tables containing all the prefixes
+ * @param addr the address to match in network order
+ * @param info caller storage that receives the next hop and interface
+ * @return hop_status_t VALID if a route was found or INVALID otherwise.
+ */
+hop_status_t bsl_lookup(const bsl_t *__restrict__ bsl, uint32_t addr, hop_info_t *__restrict__ info) {
+    if ((bsl == NULL) || (info == NULL)) {
+        return INVALID;
+    }
+
+    uint32_t key = ntohl(addr);
+    uint32_t best = 0;
+    int low = 0;
+    int high = (int)bsl->lengths_len - 1;
+
+    while (low <= high) {
+        int mid = (low + high) >> 1;
+        uint32_t length = bsl->lengths[mid];
+        const bsl_entry_t *entry = bsl_find(bsl->tables + length, key & bsl_mask(length));
+
+        if (entry != NULL) {
+            if ((entry->value & BSL_BMP_MASK) != 0) {
+                best = entry->value & BSL_BMP_MASK;
+            }
+
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    if (best == 0) {
+        info->status = INVALID;
+        return INVALID;
+    }
+
+    *info = bsl->hops[best - 1];
+
+    return VALID;
+}
+
+typedef struct bsl_route_s {
+    uint32_t prefix;
+    uint32_t length;
+    uint32_t info;
+} bsl_route_t;
+
+typedef struct bsl_routes_s {
+    bsl_route_t *routes;
+    uint32_t len;
+    uint32_t cap;
+} bsl_routes_t;
+
+static int bsl_collect(const btrie_t *__restrict__ tree, uint32_t bnode_idx, uint32_t prefix, uint32_t depth,
+                       bsl_routes_t *__restrict__ routes) {
+    const btrie_node_t *bnode = tree->nodes + bnode_idx;
+
+    if (bnode->info != BTRIE_EMPTY) {
+        if (routes->len == routes->cap) {
+            uint32_t new_cap = (routes->cap == 0) ? 1024 : (routes->cap << 1);
+            bsl_route_t *new_routes = realloc(routes->routes, sizeof *new_routes * new_cap);
+
+            if (new_routes == NULL) {
+                return -1;
+            }
+
+            routes->routes = new_routes;
+            routes->cap = new_cap;
+        }
+
+        routes->routes[routes->len].prefix = prefix;
+        routes->routes[routes->len].length = depth;
+        routes->routes[routes->len].info = bnode->info;
+        ++(routes->len);
+    }
+
+    if ((depth < 32) && (bnode->left != BTRIE_NIL) &&
+        (bsl_collect(tree, bnode->left, prefix, depth + 1, routes) != 0)) {
+        return -1;
+    }
+
+    if ((depth < 32) && (bnode->right != BTRIE_NIL) &&
+        (bsl_collect(tree, bnode->right, prefix | (1u << (31 - depth)), depth + 1, routes) != 0)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Collects the lengths where the binary search for the given
+ * length has to take a hit to continue with the longer lengths, those
+ * are the lengths where a marker is needed.
+ */
+static void bsl_marker_lengths(const bsl_t *__restrict__ bsl, uint32_t length, uint32_t *__restrict__ markers,
+                               uint32_t *__restrict__ markers_len) {
+    int low = 0;
+    int high = (int)bsl->lengths_len - 1;
+
+    *markers_len = 0;
+
+    while (low <= high) {
+        int mid = (low + high) >> 1;
+
+        if (bsl->lengths[mid] == length) {
+            break;
+        }
+
+        if (bsl->lengths[mid] < length) {
+            markers[(*markers_len)++] = bsl->lengths[mid];
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+}
+
+static uint32_t bsl_marker_bmp(const btrie_t *__restrict__ tree, uint32_t key, uint32_t length) {
+    uint32_t iter_node = BTRIE_ROOT;
+    uint32_t best = BTRIE_EMPTY;
+
+    /* The best prefix of a marker is the longest route on its path in the trie */
+    for (uint32_t depth = 0; ; ++depth) {
+        if (tree->nodes[iter_node].info != BTRIE_EMPTY) {
+            best = tree->nodes[iter_node].info;
+        }
+
+        if (depth == length) {
+            break;
+        }
+
+        iter_node = ((key << depth) >> 31) ? tree->nodes[iter_node].right : tree->nodes[iter_node].left;
+
+        /* The root is the node 0, so a missing child is checked only after a step */
+        if (iter_node == BTRIE_NIL) {
+            break;
+        }
+    }
+
+    return best;
+}
+
+static void bsl_add(bsl_table_t *__restrict__ table, uint32_t key, uint32_t value) {
+    uint32_t idx = bsl_hash(key) & table->mask;
+
+    while (table->entries[idx].value != 0) {
+        if (table->entries[idx].key == key) {
+            return;
+        }
+
+        idx = (idx + 1) & table->mask;
+    }
+
+    table->entries[idx].key = key;
+    table->entries[idx].value = value;
+    ++(table->len);
+}
+
+static int bsl_fill(bsl_t *__restrict__ bsl, const btrie_t *__restrict__ tree, const bsl_routes_t *__restrict__ routes) {
+    uint32_t counts[BSL_MAX_LENGTHS + 1] = { 0 };
+    uint32_t markers[BSL_MAX_LENGTHS];
+    uint32_t markers_len = 0;
+
+    for (uint32_t i = 0; i < routes->len; ++i) {
+        ++counts[routes->routes[i].length];
+    }
+
+    for (uint32_t length = 1; length <= BSL_MAX_LENGTHS; ++length) {
+        if (counts[length] != 0) {
+            bsl->lengths[bsl->lengths_len++] = (uint8_t)length;
+        }
+    }
+
+    /* Every route may leave a marker on the lengths visited before its own */
+    for (uint32_t i = 0; i < routes->len; ++i) {
+        bsl_marker_lengths(bsl, routes->routes[i].length, markers, &markers_len);
+
+        for (uint32_t j = 0; j < markers_len; ++j) {
+            ++counts[markers[j]];
+        }
+    }
+
+    for (uint32_t length = 1; length <= BSL_MAX_LENGTHS; ++length) {
+        if (counts[length] != 0) {
+
+            /* Keep the load factor under 1/2 */
+            uint32_t capacity = 8;
+            while (capacity < (counts[length] << 1)) {
+                capacity <<= 1;
+            }
+
+            bsl->tables[length].entries = calloc(capacity, sizeof *bsl->tables[length].entries);
+
+            if (bsl->tables[length].entries == NULL) {
+                return -1;
+            }
+
+            bsl->tables[length].mask = capacity - 1;
+        }
+    }
+
+    /* The real prefixes go first, a marker on a real prefix shares its entry */
+    for (uint32_t i = 0; i < routes->len; ++i) {
+        const bsl_route_t *route = routes->routes + i;
+
+        bsl_add(bsl->tables + route->length, route->prefix, BSL_USED | route->info);
+    }
+
+    for (uint32_t i = 0; i < routes->len; ++i) {
+        const bsl_route_t *route = routes->routes + i;
+
+        bsl_marker_lengths(bsl, route->length, markers, &markers_len);
+
+        for (uint32_t j = 0; j < markers_len; ++j) {
+            uint32_t key = route->prefix & bsl_mask(markers[j]);
+
+            if (bsl_find(bsl->tables + markers[j], key) == NULL) {
+                bsl_add(bsl->tables + markers[j], key, BSL_USED | bsl_marker_bmp(tree, key, markers[j]));
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Builds the hash tables from the routes of a binary trie,
+ * the entries keep the hop indices of the binary trie so both
+ * structures give the same longest prefix matches.
+ *
+ * @param tree the binary trie holding the routing table
+ * @return bsl_t* an allocated structure or NULL on failure
+ */
+bsl_t* bsl_build(const btrie_t *__restrict__ tree) {
+    if (tree == NULL) {
+        return NULL;
+    }
+
+    bsl_t *new_bsl = calloc(1, sizeof *new_bsl);
+
+    if (new_bsl != NULL) {
+        bsl_routes_t routes = { .routes = NULL, .len = 0, .cap = 0 };
+
+        new_bsl->hops = malloc(sizeof *new_bsl->hops * (tree->hops_len + 1));
+
+        if ((new_bsl->hops == NULL) || (bsl_collect(tree, BTRIE_ROOT, 0, 0, &routes) != 0) ||
+            (bsl_fill(new_bsl, tree, &routes) != 0)) {
+            free_bsl(&new_bsl);
+        } else {
+            memcpy(new_bsl->hops, tree->hops, sizeof *new_bsl->hops * tree->hops_len);
+            new_bsl->hops_len = tree->hops_len;
+            new_bsl->size = routes.len;
+        }
+
+        free(routes.routes);
+    }
+
+    return new_bsl;
+}
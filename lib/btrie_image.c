@@ -0,0 +1,266 @@
+#include "btrie_image.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static uint64_t btrie_image_align(uint64_t offset) {
+    return (offset + BTRIE_IMAGE_ALIGN - 1) & ~((uint64_t)BTRIE_IMAGE_ALIGN - 1);
+}
+
+static int btrie_image_pad(FILE *fout, uint64_t from, uint64_t to) {
+    static const char zeros[BTRIE_IMAGE_ALIGN];
+
+    return (fwrite(zeros, 1, (size_t)(to - from), fout) == (size_t)(to - from)) ? 0 : -1;
+}
+
+/**
+ * @brief Checks if a file starts with the magic of a trie snapshot.
+ *
+ * @param filename the file to check
+ * @return int 1 if the file is a snapshot or 0 otherwise.
+ */
+int btrie_is_image(const char *filename) {
+    if (filename == NULL) {
+        return 0;
+    }
+
+    FILE *fin = fopen(filename, "rb");
+
+    if (fin == NULL) {
+        return 0;
+    }
+
+    uint32_t magic = 0;
+    int is_image = (fread(&magic, sizeof magic, 1, fin) == 1) && (magic == BTRIE_IMAGE_MAGIC);
+
+    fclose(fin);
+
+    return is_image;
+}
+
+/**
+ * @brief Copies the live nodes in pre-order, so every child is stored
+ * after its parent and the pruned nodes are left out.
+ */
+static btrie_node_t* btrie_image_nodes(const btrie_t *__restrict__ tree, uint32_t *__restrict__ nodes_len) {
+    uint32_t *order = malloc(sizeof *order * tree->nodes_len);
+    uint32_t *renamed = malloc(sizeof *renamed * tree->nodes_len);
+    btrie_node_t *nodes = NULL;
+
+    if ((order != NULL) && (renamed != NULL)) {
+
+        /* The trie is at most 32 levels deep, every level leaves at most a right child on the stack */
+        uint32_t stack[2 * 33];
+        uint32_t top = 0, len = 0;
+
+        stack[top++] = BTRIE_ROOT;
+
+        while (top != 0) {
+            uint32_t node_idx = stack[--top];
+
+            renamed[node_idx] = len;
+            order[len++] = node_idx;
+
+            if (tree->nodes[node_idx].right != BTRIE_NIL) {
+                stack[top++] = tree->nodes[node_idx].right;
+            }
+
+            if (tree->nodes[node_idx].left != BTRIE_NIL) {
+                stack[top++] = tree->nodes[node_idx].left;
+            }
+        }
+
+        nodes = malloc(sizeof *nodes * len);
+
+        if (nodes != NULL) {
+            for (uint32_t i = 0; i < len; ++i) {
+                const btrie_node_t *bnode = tree->nodes + order[i];
+
+                nodes[i].left = (bnode->left == BTRIE_NIL) ? BTRIE_NIL : renamed[bnode->left];
+                nodes[i].right = (bnode->right == BTRIE_NIL) ? BTRIE_NIL : renamed[bnode->right];
+                nodes[i].info = bnode->info;
+            }
+
+            *nodes_len = len;
+        }
+    }
+
+    free(order);
+    free(renamed);
+
+    return nodes;
+}
+
+/**
+ * @brief Writes a snapshot of the binary trie. The image is written
+ * next to the destination and renamed over it, so a process mapping
+ * the old image never sees a partial file. The nodes are stored in
+ * pre-order, which btrie_load checks to reject cycles.
+ *
+ * @param tree the binary trie
+ * @param filename the file receiving the snapshot
+ * @return int 0 on success or -1 if the image could not be written.
+ */
+int btrie_save(const btrie_t *__restrict__ tree, const char *filename) {
+    if ((tree == NULL) || (filename == NULL)) {
+        return -1;
+    }
+
+    btrie_image_header_t header = {
+        .magic = BTRIE_IMAGE_MAGIC,
+        .version = BTRIE_IMAGE_VERSION,
+        .node_size = sizeof(btrie_node_t),
+        .hop_size = sizeof(hop_info_t),
+        .hops_len = tree->hops_len,
+        .size = tree->size
+    };
+
+    btrie_node_t *nodes = btrie_image_nodes(tree, &header.nodes_len);
+
+    if (nodes == NULL) {
+        return -1;
+    }
+
+    header.nodes_offset = btrie_image_align(sizeof header);
+    header.hops_offset = btrie_image_align(header.nodes_offset + (uint64_t)header.nodes_len * header.node_size);
+    header.image_size = header.hops_offset + (uint64_t)header.hops_len * header.hop_size;
+
+    size_t name_len = strlen(filename);
+    char *tmp_name = malloc(name_len + sizeof ".tmp");
+
+    if (tmp_name == NULL) {
+        free(nodes);
+        return -1;
+    }
+
+    memcpy(tmp_name, filename, name_len);
+    memcpy(tmp_name + name_len, ".tmp", sizeof ".tmp");
+
+    FILE *fout = fopen(tmp_name, "wb");
+    int error = (fout == NULL);
+
+    if (error == 0) {
+        error |= (fwrite(&header, sizeof header, 1, fout) != 1);
+        error |= btrie_image_pad(fout, sizeof header, header.nodes_offset);
+        error |= (fwrite(nodes, header.node_size, header.nodes_len, fout) != header.nodes_len);
+        error |= btrie_image_pad(fout, header.nodes_offset + (uint64_t)header.nodes_len * header.node_size,
+                                 header.hops_offset);
+        error |= (fwrite(tree->hops, header.hop_size, header.hops_len, fout) != header.hops_len);
+        error |= (fclose(fout) != 0);
+    }
+
+    if ((error == 0) && (rename(tmp_name, filename) != 0)) {
+        error = 1;
+    }
+
+    if (error != 0) {
+        unlink(tmp_name);
+    }
+
+    free(tmp_name);
+    free(nodes);
+
+    return (error == 0) ? 0 : -1;
+}
+
+static int btrie_image_check(const btrie_image_header_t *__restrict__ header, size_t file_size) {
+    if ((header->magic != BTRIE_IMAGE_MAGIC) || (header->version != BTRIE_IMAGE_VERSION) ||
+        (header->node_size != sizeof(btrie_node_t)) || (header->hop_size != sizeof(hop_info_t))) {
+        return -1;
+    }
+
+    /* The root has to be present and both arrays have to fit in the file */
+    if ((header->nodes_len == 0) || (header->image_size > file_size) ||
+        ((header->nodes_offset % BTRIE_IMAGE_ALIGN) != 0) || ((header->hops_offset % BTRIE_IMAGE_ALIGN) != 0) ||
+        (header->nodes_offset < sizeof *header) ||
+        (header->nodes_offset + (uint64_t)header->nodes_len * header->node_size > header->hops_offset) ||
+        (header->hops_offset + (uint64_t)header->hops_len * header->hop_size > header->image_size)) {
+        return -1;
+    }
+
+    const btrie_node_t *nodes = (const btrie_node_t *)((const char *)header + header->nodes_offset);
+
+    /*
+     * A corrupted index would send the lookups outside of the mapping, and
+     * a child stored before its parent could close a cycle that the lookups
+     * never leave, so every child has to come after its parent
+     */
+    for (uint32_t i = 0; i < header->nodes_len; ++i) {
+        if ((nodes[i].left >= header->nodes_len) || (nodes[i].right >= header->nodes_len) ||
+            ((nodes[i].left != BTRIE_NIL) && (nodes[i].left <= i)) ||
+            ((nodes[i].right != BTRIE_NIL) && (nodes[i].right <= i)) ||
+            (nodes[i].info > header->hops_len)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Maps a snapshot of the binary trie. The arrays are used in
+ * place from a shared read-only mapping, so the routers loading the
+ * same image share its pages, and they are copied to the heap by the
+ * first update of the trie.
+ *
+ * @param filename the file holding the snapshot
+ * @return btrie_t* the binary trie or NULL if the image is not valid
+ */
+btrie_t* btrie_load(const char *filename) {
+    if (filename == NULL) {
+        return NULL;
+    }
+
+    int fd = open(filename, O_RDONLY);
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    void *image = MAP_FAILED;
+
+    if ((fstat(fd, &st) == 0) && ((size_t)st.st_size >= sizeof(btrie_image_header_t))) {
+        image = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+    }
+
+    /* The mapping keeps its own reference to the file */
+    close(fd);
+
+    if (image == MAP_FAILED) {
+        return NULL;
+    }
+
+    const btrie_image_header_t *header = image;
+    btrie_t *new_tree = NULL;
+
+    if (btrie_image_check(header, (size_t)st.st_size) == 0) {
+        new_tree = malloc(sizeof *new_tree);
+    }
+
+    if (new_tree == NULL) {
+        munmap(image, (size_t)st.st_size);
+        return NULL;
+    }
+
+    new_tree->nodes = (btrie_node_t *)((char *)image + header->nodes_offset);
+    new_tree->nodes_len = header->nodes_len;
+    new_tree->nodes_cap = header->nodes_len;
+
+    new_tree->hops = (hop_info_t *)((char *)image + header->hops_offset);
+    new_tree->hops_len = header->hops_len;
+    new_tree->hops_cap = header->hops_len;
+
+    /* The released slots are not saved, they stay unreachable in the image */
+    new_tree->nodes_free = BTRIE_NIL;
+    new_tree->hops_free = BTRIE_EMPTY;
+
+    new_tree->size = (size_t)header->size;
+
+    new_tree->image = image;
+    new_tree->image_size = (size_t)st.st_size;
+
+    return new_tree;
+}
@@ -0,0 +1,393 @@
+#define _GNU_SOURCE
+
+#include "control.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Applies the pending route updates. The shadow FIB gets them
+ * first and is published, once no packet uses the old FIB anymore it
+ * gets the same updates and becomes the next shadow.
+ */
+static void control_commit(control_t *__restrict__ control, FILE *out) {
+    if (control->updates_len == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(control->lock);
+
+    fib_t *published = atomic_load(control->fib);
+    int applied = 0;
+
+    /* The shadow is copied again after the FIB was replaced by a reload */
+    if ((control->shadow == NULL) || (control->shadow_of != published->id)) {
+        free_fib(&control->shadow);
+        control->shadow = fib_clone(published);
+        control->shadow_of = published->id;
+    }
+
+    memcpy(control->replay, control->updates, sizeof *control->updates * control->updates_len);
+
+    if ((control->shadow == NULL) || (fib_update(control->shadow, control->updates, control->updates_len) != 0)) {
+        free_fib(&control->shadow);
+
+        for (size_t i = 0; i < control->updates_len; ++i) {
+            control->updates[i].status = -1;
+        }
+    }
+
+    for (size_t i = 0; i < control->updates_len; ++i) {
+        applied |= (control->updates[i].status == 0);
+    }
+
+    if (applied != 0) {
+        fib_t *old_fib = atomic_exchange(control->fib, control->shadow);
+        control->shadow_of = control->shadow->id;
+
+        rcu_synchronize(control->rcu);
+
+        /* A copy that could not follow the updates is dropped and copied again */
+        int error = (fib_update(old_fib, control->replay, control->updates_len) != 0);
+
+        for (size_t i = 0; i < control->updates_len; ++i) {
+            error |= (control->replay[i].status != control->updates[i].status);
+        }
+
+        if (error != 0) {
+            free_fib(&old_fib);
+        }
+
+        control->shadow = old_fib;
+    }
+
+    pthread_mutex_unlock(control->lock);
+
+    for (size_t i = 0; i < control->updates_len; ++i) {
+        if (control->updates[i].status == 0) {
+            fprintf(out, "ok\n");
+        } else if (control->updates[i].op == FIB_DELETE) {
+            fprintf(out, "error: no such route\n");
+        } else {
+            fprintf(out, "error: could not add the route\n");
+        }
+    }
+
+    control->updates_len = 0;
+}
+
+static void control_show_route(uint32_t prefix, uint32_t mask, uint32_t hop, int interface, void *arg) {
+    char prefix_str[INET_ADDRSTRLEN], hop_str[INET_ADDRSTRLEN], mask_str[INET_ADDRSTRLEN];
+
+    inet_ntop(AF_INET, &prefix, prefix_str, sizeof prefix_str);
+    inet_ntop(AF_INET, &hop, hop_str, sizeof hop_str);
+    inet_ntop(AF_INET, &mask, mask_str, sizeof mask_str);
+
+    fprintf(arg, "%s %s %s %d\n", prefix_str, hop_str, mask_str, interface);
+}
+
+static void control_query(control_t *__restrict__ control, FILE *out, const char *cmd, const char *args) {
+    char addr_str[INET_ADDRSTRLEN];
+    uint32_t addr;
+
+    /* The published FIB is not freed while the writers are locked out */
+    pthread_mutex_lock(control->lock);
+
+    const fib_t *published = atomic_load(control->fib);
+
+    if (strcmp(cmd, "lookup") == 0) {
+        hop_info_t info;
+
+        if ((sscanf(args, "%15s", addr_str) != 1) || (inet_pton(AF_INET, addr_str, &addr) != 1)) {
+            fprintf(out, "error: usage lookup address\n");
+        } else if (fib_lookup(published, addr, &info) == INVALID) {
+            fprintf(out, "%s unreachable\nok\n", addr_str);
+        } else {
+            char hop_str[INET_ADDRSTRLEN];
+
+            inet_ntop(AF_INET, &info.hop, hop_str, sizeof hop_str);
+            fprintf(out, "%s via %s interface %d\nok\n", addr_str, hop_str, info.interface);
+        }
+    } else if (strcmp(args, "routes") == 0) {
+        btrie_walk(published->rib, control_show_route, out);
+        fprintf(out, "ok\n");
+    } else if (args[0] == '\0') {
+        fprintf(out, "engine %s routes %zu\nok\n", published->ops->name, published->rib->size);
+    } else {
+        fprintf(out, "error: usage show [routes]\n");
+    }
+
+    pthread_mutex_unlock(control->lock);
+}
+
+static int control_mask_valid(uint32_t mask) {
+    uint32_t host_bits = ~ntohl(mask);
+
+    /* The ones of the mask have to lead, the engines store a prefix length */
+    return (host_bits & (host_bits + 1)) == 0;
+}
+
+static void control_command(control_t *__restrict__ control, FILE *out, char *line, char *end) {
+    char *args = line;
+
+    while ((args < end) && (*args != ' ') && (*args != '\t')) {
+        ++args;
+    }
+
+    char *cmd = line;
+    char *cmd_end = args;
+
+    while ((args < end) && ((*args == ' ') || (*args == '\t'))) {
+        ++args;
+    }
+
+    while ((end > args) && ((end[-1] == '\r') || (end[-1] == ' ') || (end[-1] == '\t'))) {
+        --end;
+    }
+
+    *cmd_end = '\0';
+    *end = '\0';
+
+    if ((strcmp(cmd, "add") == 0) || (strcmp(cmd, "del") == 0)) {
+        fib_update_t *update = control->updates + control->updates_len;
+        struct route_table_entry route;
+        char prefix_str[INET_ADDRSTRLEN], mask_str[INET_ADDRSTRLEN];
+        int valid;
+
+        if (cmd[0] == 'a') {
+            valid = (rtable_parse_route(args, end, &route) == 1);
+
+            update->op = FIB_INSERT;
+            update->prefix = route.prefix;
+            update->mask = route.mask;
+            update->hop = route.next_hop;
+            update->interface = route.interface;
+        } else {
+            update->op = FIB_DELETE;
+            valid = (sscanf(args, "%15s %15s", prefix_str, mask_str) == 2) &&
+                    (inet_pton(AF_INET, prefix_str, &update->prefix) == 1) &&
+                    (inet_pton(AF_INET, mask_str, &update->mask) == 1) &&
+                    (control_mask_valid(update->mask) != 0);
+        }
+
+        if (valid == 0) {
+            control_commit(control, out);
+            fprintf(out, "error: usage add prefix next_hop mask interface | del prefix mask\n");
+        } else if ((update->op == FIB_INSERT) && ((update->interface < 0) || (update->interface >= control->interfaces))) {
+
+            /* The forwarding threads send on the interface of the route without checking it again */
+            control_commit(control, out);
+            fprintf(out, "error: interface %d out of range, the router has %d\n", update->interface, control->interfaces);
+        } else if (++(control->updates_len) == CONTROL_BATCH_SIZE) {
+            control_commit(control, out);
+        }
+
+        return;
+    }
+
+    /* The replies keep the order of the commands */
+    control_commit(control, out);
+
+    if (cmd[0] == '\0') {
+        return;
+    } else if ((strcmp(cmd, "lookup") == 0) || (strcmp(cmd, "show") == 0)) {
+        control_query(control, out, cmd, args);
+    } else if (strcmp(cmd, "flush-arp") == 0) {
+        atomic_store(control->flush_arp, 1);
+        fprintf(out, "ok\n");
+    } else {
+        fprintf(out, "error: unknown command %s\n", cmd);
+    }
+}
+
+static void control_serve(control_t *__restrict__ control, int client_fd) {
+    int out_fd = dup(client_fd);
+    FILE *out = (out_fd < 0) ? NULL : fdopen(out_fd, "w");
+    char *buf = malloc(CONTROL_BUF_SIZE);
+    size_t buf_len = 0;
+
+    if ((out == NULL) || (buf == NULL)) {
+        if ((out == NULL) && (out_fd >= 0)) {
+            close(out_fd);
+        }
+
+        free(buf);
+        return;
+    }
+
+    struct pollfd fds[2] = {
+        { .fd = client_fd, .events = POLLIN },
+        { .fd = control->stop_fd, .events = POLLIN }
+    };
+
+    while ((poll(fds, 2, -1) >= 0) || (errno == EINTR)) {
+        if (fds[1].revents != 0) {
+            break;
+        }
+
+        if (fds[0].revents == 0) {
+            continue;
+        }
+
+        ssize_t len = read(client_fd, buf + buf_len, CONTROL_BUF_SIZE - buf_len);
+
+        if (len <= 0) {
+            break;
+        }
+
+        buf_len += (size_t)len;
+
+        char *line = buf;
+        char *line_end;
+
+        while ((line_end = memchr(line, '\n', (size_t)(buf + buf_len - line))) != NULL) {
+            control_command(control, out, line, line_end);
+            line = line_end + 1;
+        }
+
+        /* The updates of one read are published together */
+        control_commit(control, out);
+
+        if ((line == buf) && (buf_len == CONTROL_BUF_SIZE)) {
+            fprintf(out, "error: line too long\n");
+            buf_len = 0;
+        } else {
+            buf_len -= (size_t)(line - buf);
+            memmove(buf, line, buf_len);
+        }
+
+        if (fflush(out) != 0) {
+            break;
+        }
+    }
+
+    fclose(out);
+    free(buf);
+}
+
+static void* control_thread(void *arg) {
+    control_t *control = arg;
+
+    struct pollfd fds[2] = {
+        { .fd = control->listen_fd, .events = POLLIN },
+        { .fd = control->stop_fd, .events = POLLIN }
+    };
+
+    while ((poll(fds, 2, -1) >= 0) || (errno == EINTR)) {
+        if (fds[1].revents != 0) {
+            break;
+        }
+
+        if (fds[0].revents != 0) {
+            int client_fd = accept4(control->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+
+            /* The clients are served one after the other */
+            if (client_fd >= 0) {
+                control_serve(control, client_fd);
+                close(client_fd);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Create a control object, binds its socket and starts its thread.
+ *
+ * @param path the path of the Unix socket, an old socket is replaced
+ * @param fib where the FIB is published
+ * @param rcu the domain of the threads that read the FIB
+ * @param lock the lock taken by the writers of the FIB
+ * @param flush_arp the flag that asks the forwarding thread to drop its ARP cache
+ * @param interfaces the number of interfaces the routes may leave on
+ * @return control_t* returns the control context or NULL on failure.
+ */
+control_t* create_control(const char *path, fib_t *_Atomic *fib, rcu_t *rcu,
+                          pthread_mutex_t *lock, atomic_int *flush_arp, int interfaces) {
+    if ((path == NULL) || (fib == NULL) || (rcu == NULL) || (lock == NULL) || (flush_arp == NULL) || (interfaces <= 0)) {
+        return NULL;
+    }
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+    if (strlen(path) >= sizeof addr.sun_path) {
+        return NULL;
+    }
+
+    control_t *new_control = calloc(1, sizeof *new_control);
+
+    if (new_control == NULL) {
+        return NULL;
+    }
+
+    strcpy(addr.sun_path, path);
+    strcpy(new_control->path, path);
+
+    new_control->fib = fib;
+    new_control->rcu = rcu;
+    new_control->lock = lock;
+    new_control->flush_arp = flush_arp;
+    new_control->interfaces = interfaces;
+
+    new_control->updates = malloc(sizeof *new_control->updates * CONTROL_BATCH_SIZE);
+    new_control->replay = malloc(sizeof *new_control->replay * CONTROL_BATCH_SIZE);
+    new_control->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    new_control->stop_fd = eventfd(0, EFD_CLOEXEC);
+
+    unlink(path);
+
+    if ((new_control->updates == NULL) || (new_control->replay == NULL) || (new_control->listen_fd < 0) || (new_control->stop_fd < 0) ||
+        (bind(new_control->listen_fd, (struct sockaddr *)&addr, sizeof addr) != 0) ||
+        (chmod(path, S_IRUSR | S_IWUSR) != 0) || (listen(new_control->listen_fd, 4) != 0) ||
+        (pthread_create(&new_control->thread, NULL, control_thread, new_control) != 0)) {
+        if (new_control->listen_fd >= 0) {
+            close(new_control->listen_fd);
+            unlink(path);
+        }
+
+        if (new_control->stop_fd >= 0) {
+            close(new_control->stop_fd);
+        }
+
+        free(new_control->updates);
+        free(new_control->replay);
+        free(new_control);
+
+        return NULL;
+    }
+
+    return new_control;
+}
+
+/**
+ * @brief Stops the control thread, removes its socket and frees the
+ * shadow FIB.
+ *
+ * @param control a pointer to the control context.
+ */
+void free_control(control_t **__restrict__ control) {
+    if ((control != NULL) && (*control != NULL)) {
+        uint64_t stop = 1;
+
+        if (write((*control)->stop_fd, &stop, sizeof stop) == sizeof stop) {
+            pthread_join((*control)->thread, NULL);
+        }
+
+        close((*control)->listen_fd);
+        close((*control)->stop_fd);
+        unlink((*control)->path);
+
+        free_fib(&(*control)->shadow);
+        free((*control)->updates);
+        free((*control)->replay);
+
+        free(*control);
+        *control = NULL;
+    }
+}
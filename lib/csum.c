@@ -0,0 +1,193 @@
+#include "csum.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define CSUM_SIMD_MIN 64        /* Shorter data, an IPv4 header for example, is summed by the scalar kernel */
+
+typedef uint64_t (*csum_fn)(const uint8_t *data, size_t len, uint64_t sum);
+
+static uint64_t csum_scalar(const uint8_t *data, size_t len, uint64_t sum) {
+
+    /* Any word size works with the end around carry, the loads do not need an alignment */
+    while (len >= 8) {
+        uint64_t word;
+
+        memcpy(&word, data, sizeof word);
+        sum = csum_add(sum, word);
+
+        data += 8;
+        len -= 8;
+    }
+
+    if (len >= 4) {
+        uint32_t word;
+
+        memcpy(&word, data, sizeof word);
+        sum = csum_add(sum, word);
+
+        data += 4;
+        len -= 4;
+    }
+
+    if (len >= 2) {
+        uint16_t word;
+
+        memcpy(&word, data, sizeof word);
+        sum = csum_add(sum, word);
+
+        data += 2;
+        len -= 2;
+    }
+
+    /* The odd byte is padded with a zero byte after it */
+    if (len != 0) {
+        uint16_t word = 0;
+
+        memcpy(&word, data, 1);
+        sum = csum_add(sum, word);
+    }
+
+    return sum;
+}
+
+#if defined(__x86_64__)
+
+/*
+ * The vector kernels widen every 32-bit word to a 64-bit lane, so the
+ * lanes gather the carries and are added with the end around carry
+ * just once, at the end.
+ */
+static uint64_t csum_sse2(const uint8_t *data, size_t len, uint64_t sum) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    uint64_t lanes[2];
+
+    while (len >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)data);
+
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(block, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(block, zero));
+
+        data += 16;
+        len -= 16;
+    }
+
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    sum = csum_add(sum, lanes[0]);
+    sum = csum_add(sum, lanes[1]);
+
+    return csum_scalar(data, len, sum);
+}
+
+__attribute__((target("avx2")))
+static uint64_t csum_avx2(const uint8_t *data, size_t len, uint64_t sum) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i acc = _mm256_setzero_si256();
+    uint64_t lanes[4];
+
+    while (len >= 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)data);
+
+        acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(block, zero));
+        acc = _mm256_add_epi64(acc, _mm256_unpackhi_epi32(block, zero));
+
+        data += 32;
+        len -= 32;
+    }
+
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+
+    for (int iter = 0; iter < 4; ++iter) {
+        sum = csum_add(sum, lanes[iter]);
+    }
+
+    return csum_sse2(data, len, sum);
+}
+
+#endif
+
+static csum_fn csum_simd = csum_scalar;
+static const char *csum_simd_name = "scalar";
+
+/* The kernel is chosen once, before main and before any thread starts */
+__attribute__((constructor))
+static void csum_init(void) {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        csum_simd = csum_avx2;
+        csum_simd_name = "avx2";
+    } else {
+        csum_simd = csum_sse2;
+        csum_simd_name = "sse2";
+    }
+#endif
+}
+
+/**
+ * @brief Adds the data to a partial sum, with the vector kernel the
+ * processor supports for the longer data.
+ *
+ * @param data the data, with any alignment
+ * @param len the length of the data in bytes
+ * @param sum the partial sum of the data before, 0 for none
+ * @return uint64_t the partial sum, folded by csum_fold.
+ */
+uint64_t csum_partial(const void *data, size_t len, uint64_t sum) {
+    if (len < CSUM_SIMD_MIN) {
+        return csum_scalar(data, len, sum);
+    }
+
+    return csum_simd(data, len, sum);
+}
+
+/**
+ * @brief Replaces the kernel chosen for the processor, so the kernels
+ * can be compared with each other. It must be called before the other
+ * threads start summing.
+ *
+ * @param name "avx2", "sse2" or "scalar"
+ * @return int 0 on success or -1 if the processor lacks the kernel.
+ */
+int csum_select_kernel(const char *name) {
+    if (name == NULL) {
+        return -1;
+    }
+
+    if (strcmp(name, "scalar") == 0) {
+        csum_simd = csum_scalar;
+        csum_simd_name = "scalar";
+
+        return 0;
+    }
+
+#if defined(__x86_64__)
+    if (strcmp(name, "sse2") == 0) {
+        csum_simd = csum_sse2;
+        csum_simd_name = "sse2";
+
+        return 0;
+    }
+
+    if ((strcmp(name, "avx2") == 0) && __builtin_cpu_supports("avx2")) {
+        csum_simd = csum_avx2;
+        csum_simd_name = "avx2";
+
+        return 0;
+    }
+#endif
+
+    return -1;
+}
+
+/**
+ * @brief Returns the name of the vector kernel chosen for the processor.
+ *
+ * @return const char* "avx2", "sse2" or "scalar".
+ */
+const char* csum_kernel(void) {
+    return csum_simd_name;
+}
@@ -0,0 +1,514 @@
+#include "dir24_8.h"
+
+#include <arpa/inet.h>
+
+/**
+ * @brief Create a dir24 8 object
+ *
+ * @return dir24_8_t* returns an empty DIR-24-8 table, the tbl24 is
+ * allocated up front and the tbl8 groups are allocated on demand.
+ */
+dir24_8_t* create_dir24_8(void) {
+    dir24_8_t *new_table = malloc(sizeof *new_table);
+
+    if (new_table != NULL) {
+        new_table->tbl24 = calloc(DIR24_8_TBL24_SIZE, sizeof *new_table->tbl24);
+
+        if (new_table->tbl24 == NULL) {
+            free(new_table);
+            new_table = NULL;
+        } else {
+            new_table->tbl8 = NULL;
+            new_table->tbl8_len = 0;
+            new_table->tbl8_cap = 0;
+            new_table->tbl8_free = 0;
+
+            new_table->hops = NULL;
+            new_table->hop_refs = NULL;
+            new_table->hop_map = NULL;
+            new_table->hops_len = 0;
+            new_table->hops_cap = 0;
+            new_table->hops_free = 0;
+        }
+    }
+
+    return new_table;
+}
+
+/**
+ * @brief Frees the memory allocated for the table.
+ *
+ * @param table a pointer to the DIR-24-8 table.
+ */
+void free_dir24_8(dir24_8_t **__restrict__ table) {
+    if ((table != NULL) && (*table != NULL)) {
+        free((*table)->tbl24);
+        free((*table)->tbl8);
+        free((*table)->hops);
+        free((*table)->hop_refs);
+        free((*table)->hop_map);
+
+        free(*table);
+        *table = NULL;
+    }
+}
+
+static uint32_t dir24_8_hop_bucket(uint32_t hop, int interface, uint32_t buckets) {
+
+    /* The multiplications mix every byte of the pair into the high bits */
+    uint32_t key = (hop ^ ((uint32_t)interface * 0x85ebca6bu)) * 0x9e3779b1u;
+
+    return (uint32_t)(((uint64_t)key * buckets) >> 32);
+}
+
+static int dir24_8_grow_hops(dir24_8_t *__restrict__ table) {
+    uint32_t new_cap = (table->hops_cap == 0) ? 1024 : (table->hops_cap << 1);
+
+    if (new_cap > (DIR24_8_INDEX_MASK + 1)) {
+        return -1;
+    }
+
+    hop_info_t *new_hops = realloc(table->hops, sizeof *new_hops * new_cap);
+
+    if (new_hops == NULL) {
+        return -1;
+    }
+
+    table->hops = new_hops;
+
+    uint32_t *new_refs = realloc(table->hop_refs, sizeof *new_refs * new_cap);
+
+    if (new_refs == NULL) {
+        return -1;
+    }
+
+    table->hop_refs = new_refs;
+
+    uint32_t buckets = new_cap << 1;
+    uint32_t *new_map = calloc(buckets, sizeof *new_map);
+
+    if (new_map == NULL) {
+        return -1;
+    }
+
+    /* The next hops in the old map are placed again in the larger one */
+    for (uint32_t i = 0; i < (table->hops_cap << 1); ++i) {
+        if (table->hop_map[i] != 0) {
+            const hop_info_t *info = table->hops + (table->hop_map[i] - 1);
+            uint32_t bucket = dir24_8_hop_bucket(info->hop, info->interface, buckets);
+
+            while (new_map[bucket] != 0) {
+                bucket = (bucket + 1) & (buckets - 1);
+            }
+
+            new_map[bucket] = table->hop_map[i];
+        }
+    }
+
+    free(table->hop_map);
+    table->hop_map = new_map;
+    table->hops_cap = new_cap;
+
+    return 0;
+}
+
+/**
+ * @brief Finds the slot of a next hop, a new next hop takes a free
+ * slot without any reference, so the caller points an entry at it
+ * or gives it back with dir24_8_trim_hop.
+ */
+static int dir24_8_get_hop(dir24_8_t *__restrict__ table, uint32_t hop, int interface) {
+    if (table->hops_cap != 0) {
+        uint32_t mask = (table->hops_cap << 1) - 1;
+
+        for (uint32_t bucket = dir24_8_hop_bucket(hop, interface, mask + 1); table->hop_map[bucket] != 0;
+             bucket = (bucket + 1) & mask) {
+            const hop_info_t *info = table->hops + (table->hop_map[bucket] - 1);
+
+            if ((info->hop == hop) && (info->interface == interface)) {
+                return (int)(table->hop_map[bucket] - 1);
+            }
+        }
+    }
+
+    uint32_t idx;
+
+    if (table->hops_free != 0) {
+        idx = table->hops_free - 1;
+        table->hops_free = table->hops[idx].hop;
+    } else {
+        if ((table->hops_len == table->hops_cap) && (dir24_8_grow_hops(table) != 0)) {
+            return -1;
+        }
+
+        idx = table->hops_len++;
+    }
+
+    table->hops[idx].hop = hop;
+    table->hops[idx].interface = interface;
+    table->hops[idx].status = VALID;
+    table->hop_refs[idx] = 0;
+
+    uint32_t mask = (table->hops_cap << 1) - 1;
+    uint32_t bucket = dir24_8_hop_bucket(hop, interface, mask + 1);
+
+    while (table->hop_map[bucket] != 0) {
+        bucket = (bucket + 1) & mask;
+    }
+
+    table->hop_map[bucket] = idx + 1;
+
+    return (int)idx;
+}
+
+static void dir24_8_put_hop(dir24_8_t *__restrict__ table, uint32_t idx) {
+    uint32_t mask = (table->hops_cap << 1) - 1;
+    const hop_info_t *info = table->hops + idx;
+    uint32_t hole = dir24_8_hop_bucket(info->hop, info->interface, mask + 1);
+
+    while (table->hop_map[hole] != idx + 1) {
+        hole = (hole + 1) & mask;
+    }
+
+    /* Move back the next hops that probed over the freed bucket */
+    for (uint32_t next = (hole + 1) & mask; table->hop_map[next] != 0; next = (next + 1) & mask) {
+        const hop_info_t *moved = table->hops + (table->hop_map[next] - 1);
+        uint32_t home = dir24_8_hop_bucket(moved->hop, moved->interface, mask + 1);
+
+        /* A next hop stays if its home bucket lies cyclically in (hole, next] */
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            table->hop_map[hole] = table->hop_map[next];
+            hole = next;
+        }
+    }
+
+    table->hop_map[hole] = 0;
+
+    table->hops[idx].hop = table->hops_free;
+    table->hops[idx].status = INVALID;
+    table->hops_free = idx + 1;
+}
+
+static void dir24_8_trim_hop(dir24_8_t *__restrict__ table, int idx) {
+
+    /* A route hidden by more specific ones everywhere does not keep its next hop */
+    if (table->hop_refs[idx] == 0) {
+        dir24_8_put_hop(table, (uint32_t)idx);
+    }
+}
+
+static void dir24_8_ref(dir24_8_t *__restrict__ table, uint32_t entry) {
+    if ((entry & (DIR24_8_VALID | DIR24_8_EXT)) == DIR24_8_VALID) {
+        ++(table->hop_refs[entry & DIR24_8_INDEX_MASK]);
+    }
+}
+
+static void dir24_8_unref(dir24_8_t *__restrict__ table, uint32_t entry) {
+    if ((entry & (DIR24_8_VALID | DIR24_8_EXT)) == DIR24_8_VALID) {
+        uint32_t idx = entry & DIR24_8_INDEX_MASK;
+
+        if (--(table->hop_refs[idx]) == 0) {
+            dir24_8_put_hop(table, idx);
+        }
+    }
+}
+
+static void dir24_8_set(dir24_8_t *__restrict__ table, uint32_t *__restrict__ slot, uint32_t entry) {
+
+    /* The new next hop is counted first, so rewriting an entry with itself keeps its slot */
+    dir24_8_ref(table, entry);
+    dir24_8_unref(table, *slot);
+
+    *slot = entry;
+}
+
+static int dir24_8_new_tbl8(dir24_8_t *__restrict__ table, uint32_t entry) {
+    uint32_t idx;
+
+    if (table->tbl8_free != 0) {
+        idx = table->tbl8_free - 1;
+        table->tbl8_free = table->tbl8[(size_t)idx * DIR24_8_TBL8_SIZE];
+    } else {
+        if (table->tbl8_len == table->tbl8_cap) {
+            uint32_t new_cap = (table->tbl8_cap == 0) ? 64 : (table->tbl8_cap << 1);
+
+            if (new_cap > (DIR24_8_INDEX_MASK + 1)) {
+                return -1;
+            }
+
+            uint32_t *new_tbl8 = realloc(table->tbl8, sizeof *new_tbl8 * DIR24_8_TBL8_SIZE * new_cap);
+
+            if (new_tbl8 == NULL) {
+                return -1;
+            }
+
+            table->tbl8 = new_tbl8;
+            table->tbl8_cap = new_cap;
+        }
+
+        idx = table->tbl8_len++;
+    }
+
+    /* The new group inherits the route that covered the whole /24 */
+    uint32_t *group = table->tbl8 + (size_t)idx * DIR24_8_TBL8_SIZE;
+    for (uint32_t i = 0; i < DIR24_8_TBL8_SIZE; ++i) {
+        dir24_8_ref(table, entry);
+        group[i] = entry;
+    }
+
+    return (int)idx;
+}
+
+static void dir24_8_merge_tbl8(dir24_8_t *__restrict__ table, uint32_t idx) {
+    uint32_t group_idx = table->tbl24[idx] & DIR24_8_INDEX_MASK;
+    uint32_t *group = table->tbl8 + (size_t)group_idx * DIR24_8_TBL8_SIZE;
+
+    for (uint32_t i = 1; i < DIR24_8_TBL8_SIZE; ++i) {
+        if (group[i] != group[0]) {
+            return;
+        }
+    }
+
+    /* A group left with a single route of at most 24 bits goes back into the tbl24 entry */
+    dir24_8_set(table, table->tbl24 + idx, group[0]);
+
+    for (uint32_t i = 0; i < DIR24_8_TBL8_SIZE; ++i) {
+        dir24_8_unref(table, group[i]);
+    }
+
+    group[0] = table->tbl8_free;
+    table->tbl8_free = group_idx + 1;
+}
+
+static void dir24_8_fill(dir24_8_t *__restrict__ table, uint32_t *__restrict__ entries, uint32_t count,
+                         uint32_t entry, uint32_t depth) {
+    for (uint32_t i = 0; i < count; ++i) {
+
+        /* Never overwrite a route that is more specific than the new one */
+        if (((entries[i] & DIR24_8_VALID) == 0) ||
+            (((entries[i] & DIR24_8_DEPTH_MASK) >> DIR24_8_DEPTH_SHIFT) <= depth)) {
+            dir24_8_set(table, entries + i, entry);
+        }
+    }
+}
+
+/**
+ * @brief Inserts an entry into the DIR-24-8 table, the order of
+ * the insertions does not matter because every entry remembers
+ * the length of the prefix that wrote it.
+ *
+ * @param table the DIR-24-8 table
+ * @param prefix the prefix to insert in the table
+ * @param mask the mask of the prefix
+ * @param hop the hop described by the prefix
+ * @param interface the interface described by the prefix
+ * @return int 0 on success or -1 if the table could not grow.
+ */
+int dir24_8_insert(dir24_8_t *__restrict__ table, uint32_t prefix, uint32_t mask, uint32_t hop, int interface) {
+    if (table == NULL) {
+        return -1;
+    }
+
+    uint32_t depth = (uint32_t)__builtin_popcount(mask);
+
+    /* The binary trie does not store empty prefixes either */
+    if (depth == 0) {
+        return 0;
+    }
+
+    int hop_idx = dir24_8_get_hop(table, hop, interface);
+
+    if (hop_idx < 0) {
+        return -1;
+    }
+
+    uint32_t addr = ntohl(prefix & mask);
+    uint32_t entry = DIR24_8_VALID | (depth << DIR24_8_DEPTH_SHIFT) | (uint32_t)hop_idx;
+
+    if (depth <= 24) {
+        uint32_t first = (addr >> 8);
+        uint32_t count = (1u << (24 - depth));
+
+        for (uint32_t i = first; i < first + count; ++i) {
+            uint32_t old_entry = table->tbl24[i];
+
+            if ((old_entry & DIR24_8_EXT) != 0) {
+
+                /* Update just the less specific routes from the overflow group */
+                uint32_t *group = table->tbl8 + (size_t)(old_entry & DIR24_8_INDEX_MASK) * DIR24_8_TBL8_SIZE;
+                dir24_8_fill(table, group, DIR24_8_TBL8_SIZE, entry, depth);
+            } else {
+                dir24_8_fill(table, table->tbl24 + i, 1, entry, depth);
+            }
+        }
+    } else {
+        uint32_t idx = (addr >> 8);
+
+        if ((table->tbl24[idx] & DIR24_8_EXT) == 0) {
+            int group_idx = dir24_8_new_tbl8(table, table->tbl24[idx]);
+
+            if (group_idx < 0) {
+                dir24_8_trim_hop(table, hop_idx);
+                return -1;
+            }
+
+            dir24_8_set(table, table->tbl24 + idx, DIR24_8_VALID | DIR24_8_EXT | (uint32_t)group_idx);
+        }
+
+        uint32_t *group = table->tbl8 + (size_t)(table->tbl24[idx] & DIR24_8_INDEX_MASK) * DIR24_8_TBL8_SIZE;
+        dir24_8_fill(table, group + (addr & 0xff), (1u << (32 - depth)), entry, depth);
+    }
+
+    dir24_8_trim_hop(table, hop_idx);
+
+    return 0;
+}
+
+static void dir24_8_replace(dir24_8_t *__restrict__ table, uint32_t *__restrict__ entries, uint32_t count,
+                            uint32_t entry, uint32_t depth) {
+    for (uint32_t i = 0; i < count; ++i) {
+
+        /* Just the entries written by the deleted prefix have the same length */
+        if (((entries[i] & DIR24_8_VALID) != 0) &&
+            (((entries[i] & DIR24_8_DEPTH_MASK) >> DIR24_8_DEPTH_SHIFT) == depth)) {
+            dir24_8_set(table, entries + i, entry);
+        }
+    }
+}
+
+/**
+ * @brief Deletes an entry from the DIR-24-8 table, the entries of
+ * the prefix are taken over by the route that covers it. A tbl8
+ * group left with a single route is merged back into its tbl24
+ * entry and, like a next hop without entries, reused later.
+ *
+ * @param table the DIR-24-8 table
+ * @param prefix the prefix to delete from the table
+ * @param mask the mask of the prefix
+ * @param cover the route covering the prefix or NULL if there is none
+ * @param cover_mask the mask of the covering route
+ * @return int 0 on success or -1 if the table could not grow.
+ */
+int dir24_8_delete(dir24_8_t *__restrict__ table, uint32_t prefix, uint32_t mask,
+                   const hop_info_t *__restrict__ cover, uint32_t cover_mask) {
+    if (table == NULL) {
+        return -1;
+    }
+
+    uint32_t depth = (uint32_t)__builtin_popcount(mask);
+
+    if (depth == 0) {
+        return 0;
+    }
+
+    uint32_t entry = 0;
+    int hop_idx = -1;
+
+    if ((cover != NULL) && (cover->status == VALID)) {
+        hop_idx = dir24_8_get_hop(table, cover->hop, cover->interface);
+
+        if (hop_idx < 0) {
+            return -1;
+        }
+
+        entry = DIR24_8_VALID | ((uint32_t)__builtin_popcount(cover_mask) << DIR24_8_DEPTH_SHIFT) | (uint32_t)hop_idx;
+    }
+
+    uint32_t addr = ntohl(prefix & mask);
+
+    if (depth <= 24) {
+        uint32_t first = (addr >> 8);
+        uint32_t count = (1u << (24 - depth));
+
+        for (uint32_t i = first; i < first + count; ++i) {
+            uint32_t old_entry = table->tbl24[i];
+
+            if ((old_entry & DIR24_8_EXT) != 0) {
+                uint32_t *group = table->tbl8 + (size_t)(old_entry & DIR24_8_INDEX_MASK) * DIR24_8_TBL8_SIZE;
+                dir24_8_replace(table, group, DIR24_8_TBL8_SIZE, entry, depth);
+            } else {
+                dir24_8_replace(table, table->tbl24 + i, 1, entry, depth);
+            }
+        }
+    } else if ((table->tbl24[addr >> 8] & DIR24_8_EXT) != 0) {
+        uint32_t *group = table->tbl8 + (size_t)(table->tbl24[addr >> 8] & DIR24_8_INDEX_MASK) * DIR24_8_TBL8_SIZE;
+        dir24_8_replace(table, group + (addr & 0xff), (1u << (32 - depth)), entry, depth);
+        dir24_8_merge_tbl8(table, addr >> 8);
+    }
+
+    if (hop_idx >= 0) {
+        dir24_8_trim_hop(table, hop_idx);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Computes the longest prefix match with at most two
+ * memory accesses in the table.
+ *
+ * @param table the DIR-24-8 table containing all the prefixes
+ * @param addr the address to match in network order
+ * @param info caller storage that receives the next hop and interface
+ * @return hop_status_t VALID if a route was found or INVALID otherwise.
+ */
+hop_status_t dir24_8_lookup(const dir24_8_t *__restrict__ table, uint32_t addr, hop_info_t *__restrict__ info) {
+    if ((table == NULL) || (info == NULL)) {
+        return INVALID;
+    }
+
+    addr = ntohl(addr);
+
+    uint32_t entry = table->tbl24[addr >> 8];
+
+    if ((entry & DIR24_8_EXT) != 0) {
+        entry = table->tbl8[((size_t)(entry & DIR24_8_INDEX_MASK) << 8) | (addr & 0xff)];
+    }
+
+    if ((entry & DIR24_8_VALID) == 0) {
+        info->status = INVALID;
+        return INVALID;
+    }
+
+    *info = table->hops[entry & DIR24_8_INDEX_MASK];
+
+    return VALID;
+}
+
+typedef struct dir24_8_build_s {
+    dir24_8_t *table;
+    int error;
+} dir24_8_build_t;
+
+static void dir24_8_build_route(uint32_t prefix, uint32_t mask, uint32_t hop, int interface, void *arg) {
+    dir24_8_build_t *build = arg;
+
+    if ((build->error == 0) && (dir24_8_insert(build->table, prefix, mask, hop, interface) != 0)) {
+        build->error = 1;
+    }
+}
+
+/**
+ * @brief Builds a DIR-24-8 table from the routes of a binary trie,
+ * so both structures give the same longest prefix matches.
+ *
+ * @param tree the binary trie holding the routing table
+ * @return dir24_8_t* an allocated DIR-24-8 table or NULL on failure
+ */
+dir24_8_t* dir24_8_build(const btrie_t *__restrict__ tree) {
+    if (tree == NULL) {
+        return NULL;
+    }
+
+    dir24_8_build_t build = { .table = create_dir24_8(), .error = 0 };
+
+    if (build.table != NULL) {
+        btrie_walk(tree, dir24_8_build_route, &build);
+
+        if (build.error != 0) {
+            free_dir24_8(&build.table);
+        }
+    }
+
+    return build.table;
+}
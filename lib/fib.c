@@ -0,0 +1,408 @@
+#include "fib.h"
+
+#include "dir24_8.h"
+#include "poptrie.h"
+#include "bsl.h"
+#include "btrie_image.h"
+
+#include <stdatomic.h>
+
+static atomic_uint_fast64_t fib_ids = 1;
+
+static void* trie_build(btrie_t *rib) {
+
+    /* The trie engine matches directly on the routes */
+    return rib;
+}
+
+static hop_status_t trie_lookup(const void *engine, uint32_t addr, hop_info_t *info) {
+    return btrie_lookup(engine, addr, info);
+}
+
+static void trie_lookup_batch(const void *engine, const uint32_t *addrs, hop_info_t *infos, size_t count) {
+    btrie_lookup_batch(engine, addrs, infos, count);
+}
+
+static int trie_insert(void **engine, btrie_t *rib, uint32_t prefix, uint32_t mask, uint32_t hop, int interface) {
+    return 0;
+}
+
+static int trie_delete(void **engine, btrie_t *rib, uint32_t prefix, uint32_t mask) {
+    return 0;
+}
+
+static void trie_free(void **engine) {
+
+    /* The routes are released together with the FIB */
+    *engine = NULL;
+}
+
+static void* dir24_8_build_engine(btrie_t *rib) {
+    return dir24_8_build(rib);
+}
+
+static hop_status_t dir24_8_lookup_engine(const void *engine, uint32_t addr, hop_info_t *info) {
+    return dir24_8_lookup(engine, addr, info);
+}
+
+static int dir24_8_insert_engine(void **engine, btrie_t *rib, uint32_t prefix, uint32_t mask, uint32_t hop, int interface) {
+    return dir24_8_insert(*engine, prefix, mask, hop, interface);
+}
+
+static int dir24_8_delete_engine(void **engine, btrie_t *rib, uint32_t prefix, uint32_t mask) {
+    hop_info_t cover = { .status = INVALID };
+    uint32_t cover_mask = 0;
+
+    /* The entries of the deleted prefix go to the route that covers it */
+    btrie_cover(rib, prefix, mask, &cover, &cover_mask);
+
+    return dir24_8_delete(*engine, prefix, mask, &cover, cover_mask);
+}
+
+static void dir24_8_free_engine(void **engine) {
+    free_dir24_8((dir24_8_t **)engine);
+}
+
+static void* poptrie_build_engine(btrie_t *rib) {
+    return poptrie_build(rib);
+}
+
+static hop_status_t poptrie_lookup_engine(const void *engine, uint32_t addr, hop_info_t *info) {
+    return poptrie_lookup(engine, addr, info);
+}
+
+static int poptrie_rebuild_engine(void **engine, btrie_t *rib) {
+    poptrie_t *new_trie = poptrie_build(rib);
+
+    if (new_trie == NULL) {
+        return -1;
+    }
+
+    free_poptrie((poptrie_t **)engine);
+    *engine = new_trie;
+
+    return 0;
+}
+
+static int poptrie_insert_engine(void **engine, btrie_t *rib, uint32_t prefix, uint32_t mask, uint32_t hop, int interface) {
+    return poptrie_rebuild_engine(engine, rib);
+}
+
+static int poptrie_delete_engine(void **engine, btrie_t *rib, uint32_t prefix, uint32_t mask) {
+    return poptrie_rebuild_engine(engine, rib);
+}
+
+static void poptrie_free_engine(void **engine) {
+    free_poptrie((poptrie_t **)engine);
+}
+
+static void* bsl_build_engine(btrie_t *rib) {
+    return bsl_build(rib);
+}
+
+static hop_status_t bsl_lookup_engine(const void *engine, uint32_t addr, hop_info_t *info) {
+    return bsl_lookup(engine, addr, info);
+}
+
+static int bsl_rebuild_engine(void **engine, btrie_t *rib) {
+    bsl_t *new_bsl = bsl_build(rib);
+
+    if (new_bsl == NULL) {
+        return -1;
+    }
+
+    free_bsl((bsl_t **)engine);
+    *engine = new_bsl;
+
+    return 0;
+}
+
+static int bsl_insert_engine(void **engine, btrie_t *rib, uint32_t prefix, uint32_t mask, uint32_t hop, int interface) {
+    return bsl_rebuild_engine(engine, rib);
+}
+
+static int bsl_delete_engine(void **engine, btrie_t *rib, uint32_t prefix, uint32_t mask) {
+    return bsl_rebuild_engine(engine, rib);
+}
+
+static void bsl_free_engine(void **engine) {
+    free_bsl((bsl_t **)engine);
+}
+
+static const fib_ops_t fib_engines[] = {
+    {
+        .name = "trie",
+        .build = trie_build,
+        .lookup = trie_lookup,
+        .lookup_batch = trie_lookup_batch,
+        .insert = trie_insert,
+        .delete = trie_delete,
+        .rebuild = NULL,
+        .free = trie_free
+    },
+    {
+        .name = "dir24-8",
+        .build = dir24_8_build_engine,
+        .lookup = dir24_8_lookup_engine,
+        .lookup_batch = NULL,
+        .insert = dir24_8_insert_engine,
+        .delete = dir24_8_delete_engine,
+        .rebuild = NULL,
+        .free = dir24_8_free_engine
+    },
+    {
+        .name = "poptrie",
+        .build = poptrie_build_engine,
+        .lookup = poptrie_lookup_engine,
+        .lookup_batch = NULL,
+        .insert = poptrie_insert_engine,
+        .delete = poptrie_delete_engine,
+        .rebuild = poptrie_rebuild_engine,
+        .free = poptrie_free_engine
+    },
+    {
+        .name = "bsl",
+        .build = bsl_build_engine,
+        .lookup = bsl_lookup_engine,
+        .lookup_batch = NULL,
+        .insert = bsl_insert_engine,
+        .delete = bsl_delete_engine,
+        .rebuild = bsl_rebuild_engine,
+        .free = bsl_free_engine
+    }
+};
+
+/**
+ * @brief Finds the operations of a lookup engine by its name.
+ *
+ * @param name the name of the engine (trie, dir24-8, poptrie or bsl)
+ * @return const fib_ops_t* the operations or NULL if the engine is unknown.
+ */
+const fib_ops_t* fib_find_ops(const char *name) {
+    if (name != NULL) {
+        for (size_t i = 0; i < sizeof fib_engines / sizeof *fib_engines; ++i) {
+            if (strcmp(fib_engines[i].name, name) == 0) {
+                return fib_engines + i;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Builds a FIB over a binary trie of routes, the FIB takes
+ * the ownership of the trie only if the build succeeds.
+ *
+ * @param ops the operations of the lookup engine
+ * @param rib the binary trie holding the routes
+ * @return fib_t* an allocated FIB or NULL on failure
+ */
+fib_t* fib_build(const fib_ops_t *ops, btrie_t *rib) {
+    if ((ops == NULL) || (rib == NULL)) {
+        return NULL;
+    }
+
+    fib_t *new_fib = malloc(sizeof *new_fib);
+
+    if (new_fib != NULL) {
+        new_fib->ops = ops;
+        new_fib->rib = rib;
+        new_fib->engine = ops->build(rib);
+        new_fib->id = atomic_fetch_add(&fib_ids, 1);
+
+        if (new_fib->engine == NULL) {
+            free(new_fib);
+            new_fib = NULL;
+        }
+    }
+
+    return new_fib;
+}
+
+/**
+ * @brief Copies a FIB, the copy gets its own routes and engine,
+ * so it can be updated while the original is still used.
+ *
+ * @param fib the forwarding information base
+ * @return fib_t* an allocated copy of the FIB or NULL on failure
+ */
+fib_t* fib_clone(const fib_t *__restrict__ fib) {
+    if (fib == NULL) {
+        return NULL;
+    }
+
+    btrie_t *rib = btrie_clone(fib->rib);
+    fib_t *new_fib = fib_build(fib->ops, rib);
+
+    if (new_fib == NULL) {
+        free_btrie(&rib);
+    }
+
+    return new_fib;
+}
+
+/**
+ * @brief Reads a file of routes, or maps a compiled snapshot of it,
+ * and builds the FIB with the given engine.
+ *
+ * @param name the name of the lookup engine
+ * @param filename the file to read the routes
+ * @return fib_t* an allocated FIB or NULL on failure
+ */
+fib_t* fib_rtable(const char *name, const char *filename) {
+    const fib_ops_t *ops = fib_find_ops(name);
+
+    if (ops == NULL) {
+        return NULL;
+    }
+
+    /* A compiled snapshot is mapped as it is instead of being parsed */
+    btrie_t *rib = btrie_is_image(filename) ? btrie_load(filename) : btrie_rtable(filename);
+    fib_t *new_fib = fib_build(ops, rib);
+
+    if (new_fib == NULL) {
+        free_btrie(&rib);
+    }
+
+    return new_fib;
+}
+
+/**
+ * @brief Frees the memory allocated for the FIB, its engine and its routes.
+ *
+ * @param fib a pointer to the FIB.
+ */
+void free_fib(fib_t **__restrict__ fib) {
+    if ((fib != NULL) && (*fib != NULL)) {
+        (*fib)->ops->free(&(*fib)->engine);
+        free_btrie(&(*fib)->rib);
+
+        free(*fib);
+        *fib = NULL;
+    }
+}
+
+/**
+ * @brief Inserts (or replaces) a route in the FIB.
+ *
+ * @param fib the forwarding information base
+ * @param prefix the prefix to insert
+ * @param mask the mask of the prefix
+ * @param hop the hop described by the prefix
+ * @param interface the interface described by the prefix
+ * @return int 0 on success or -1 if the engine could not be updated.
+ */
+int fib_insert(fib_t *__restrict__ fib, uint32_t prefix, uint32_t mask, uint32_t hop, int interface) {
+    if ((fib == NULL) || (btrie_insert(fib->rib, prefix, mask, hop, interface) != 0)) {
+        return -1;
+    }
+
+    return fib->ops->insert(&fib->engine, fib->rib, prefix, mask, hop, interface);
+}
+
+/**
+ * @brief Changes the next hop of a route that is already in the FIB.
+ *
+ * @param fib the forwarding information base
+ * @param prefix the prefix of the route
+ * @param mask the mask of the prefix
+ * @param hop the new hop of the route
+ * @param interface the new interface of the route
+ * @return int 0 on success or -1 if the route does not exist or the
+ * engine could not be updated.
+ */
+int fib_replace(fib_t *__restrict__ fib, uint32_t prefix, uint32_t mask, uint32_t hop, int interface) {
+    if ((fib == NULL) || (btrie_replace(fib->rib, prefix, mask, hop, interface) != 0)) {
+        return -1;
+    }
+
+    /* Every engine overwrites a prefix it already holds */
+    return fib->ops->insert(&fib->engine, fib->rib, prefix, mask, hop, interface);
+}
+
+/**
+ * @brief Withdraws a route from the FIB.
+ *
+ * @param fib the forwarding information base
+ * @param prefix the prefix to delete
+ * @param mask the mask of the prefix
+ * @return int 0 on success or -1 if the route does not exist or the
+ * engine could not be updated.
+ */
+int fib_delete(fib_t *__restrict__ fib, uint32_t prefix, uint32_t mask) {
+    if ((fib == NULL) || (btrie_delete(fib->rib, prefix, mask) != 0)) {
+        return -1;
+    }
+
+    return fib->ops->delete(&fib->engine, fib->rib, prefix, mask);
+}
+
+/**
+ * @brief Applies a batch of route updates to the FIB. An engine that
+ * rebuilds itself is rebuilt once after all the routes were updated,
+ * the others get every update incrementally.
+ *
+ * @param fib the forwarding information base
+ * @param updates the updates, their status receives the result
+ * @param count the number of updates
+ * @return int 0 on success or -1 if the engine could not be updated,
+ * the FIB should not be used anymore in that case.
+ */
+int fib_update(fib_t *__restrict__ fib, fib_update_t *__restrict__ updates, size_t count) {
+    if (fib == NULL) {
+        return -1;
+    }
+
+    int changed = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        fib_update_t *update = updates + i;
+
+        if (update->op == FIB_INSERT) {
+            update->status = btrie_insert(fib->rib, update->prefix, update->mask, update->hop, update->interface);
+        } else {
+            update->status = btrie_delete(fib->rib, update->prefix, update->mask);
+        }
+
+        if ((update->status != 0) || (fib->ops->rebuild != NULL)) {
+            changed |= (update->status == 0);
+            continue;
+        }
+
+        int error = (update->op == FIB_INSERT) ?
+                    fib->ops->insert(&fib->engine, fib->rib, update->prefix, update->mask, update->hop, update->interface) :
+                    fib->ops->delete(&fib->engine, fib->rib, update->prefix, update->mask);
+
+        if (error != 0) {
+            return -1;
+        }
+    }
+
+    if ((changed != 0) && (fib->ops->rebuild(&fib->engine, fib->rib) != 0)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Computes the longest prefix match for a batch of addresses,
+ * engines that can interleave the lookups do it to hide the latency
+ * of the memory accesses.
+ *
+ * @param fib the forwarding information base
+ * @param addrs the addresses to match in network order
+ * @param infos caller storage that receives a result for every address
+ * @param count the number of addresses in the batch
+ */
+void fib_lookup_batch(const fib_t *__restrict__ fib, const uint32_t *__restrict__ addrs,
+                      hop_info_t *__restrict__ infos, size_t count) {
+    if (fib->ops->lookup_batch != NULL) {
+        fib->ops->lookup_batch(fib->engine, addrs, infos, count);
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            fib->ops->lookup(fib->engine, addrs[i], infos + i);
+        }
+    }
+}
@@ -0,0 +1,148 @@
+#include "fib_reload.h"
+
+#include <time.h>
+
+static int fib_reload_changed(fib_reload_t *__restrict__ reload) {
+    struct stat st;
+
+    /* A file that is missing while it is being replaced is checked again later */
+    if (stat(reload->path, &st) != 0) {
+        return 0;
+    }
+
+    return (st.st_dev != reload->st.st_dev) || (st.st_ino != reload->st.st_ino) ||
+           (st.st_size != reload->st.st_size) ||
+           (st.st_mtim.tv_sec != reload->st.st_mtim.tv_sec) || (st.st_mtim.tv_nsec != reload->st.st_mtim.tv_nsec);
+}
+
+static void* fib_reload_thread(void *arg) {
+    fib_reload_t *reload = arg;
+
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, FIB_RELOAD_SIGNAL);
+
+    struct timespec timeout = {
+        .tv_sec = FIB_RELOAD_INTERVAL_MS / 1000,
+        .tv_nsec = (FIB_RELOAD_INTERVAL_MS % 1000) * 1000000L
+    };
+
+    while (atomic_load(&reload->stop) == 0) {
+        int sig = sigtimedwait(&set, NULL, &timeout);
+
+        if (atomic_load(&reload->stop) != 0) {
+            break;
+        }
+
+        if ((sig == FIB_RELOAD_SIGNAL) || fib_reload_changed(reload)) {
+            fib_reload(reload);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Rebuilds the FIB from the routing table file and publishes it.
+ * The old FIB is freed once every forwarding thread went through a
+ * quiescent state, if the file can not be read the old FIB is kept.
+ *
+ * @param reload the reload context
+ * @return int 0 if the new FIB was published or -1 otherwise.
+ */
+int fib_reload(fib_reload_t *__restrict__ reload) {
+    if (reload == NULL) {
+        return -1;
+    }
+
+    /* The state is taken first, so a change during the build is seen again */
+    if (stat(reload->path, &reload->st) != 0) {
+        fprintf(stderr, "Could not reload %s\n", reload->path);
+        return -1;
+    }
+
+    fib_t *new_fib = fib_rtable(reload->engine, reload->path);
+
+    if (new_fib == NULL) {
+        fprintf(stderr, "Could not reload %s\n", reload->path);
+        return -1;
+    }
+
+    pthread_mutex_lock(reload->lock);
+    fib_t *old_fib = atomic_exchange(reload->fib, new_fib);
+    pthread_mutex_unlock(reload->lock);
+
+    rcu_synchronize(reload->rcu);
+    free_fib(&old_fib);
+
+    fprintf(stderr, "Reloaded %zu routes from %s\n", new_fib->rib->size, reload->path);
+
+    return 0;
+}
+
+/**
+ * @brief Create a fib reload object and starts its thread. The reload
+ * signal is blocked in the calling thread and in the threads created
+ * after it, so it has to be called before the other threads start.
+ *
+ * @param path the routing table file
+ * @param engine the name of the lookup engine
+ * @param fib where the FIB is published
+ * @param rcu the domain of the threads that read the FIB
+ * @param lock the lock taken by the writers of the FIB
+ * @return fib_reload_t* returns the reload context or NULL on failure.
+ */
+fib_reload_t* create_fib_reload(const char *path, const char *engine, fib_t *_Atomic *fib,
+                                rcu_t *rcu, pthread_mutex_t *lock) {
+    if ((path == NULL) || (engine == NULL) || (fib == NULL) || (rcu == NULL) || (lock == NULL)) {
+        return NULL;
+    }
+
+    fib_reload_t *new_reload = malloc(sizeof *new_reload);
+
+    if (new_reload == NULL) {
+        return NULL;
+    }
+
+    new_reload->path = path;
+    new_reload->engine = engine;
+    new_reload->fib = fib;
+    new_reload->rcu = rcu;
+    new_reload->lock = lock;
+    atomic_init(&new_reload->stop, 0);
+
+    /* The published FIB was built from the file as it is now */
+    if (stat(path, &new_reload->st) != 0) {
+        memset(&new_reload->st, 0, sizeof new_reload->st);
+    }
+
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, FIB_RELOAD_SIGNAL);
+
+    if ((pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) ||
+        (pthread_create(&new_reload->thread, NULL, fib_reload_thread, new_reload) != 0)) {
+        free(new_reload);
+        return NULL;
+    }
+
+    return new_reload;
+}
+
+/**
+ * @brief Stops the reload thread and frees the reload context.
+ *
+ * @param reload a pointer to the reload context.
+ */
+void free_fib_reload(fib_reload_t **__restrict__ reload) {
+    if ((reload != NULL) && (*reload != NULL)) {
+        atomic_store(&(*reload)->stop, 1);
+
+        /* Wake up the thread instead of waiting for the next check of the file */
+        pthread_kill((*reload)->thread, FIB_RELOAD_SIGNAL);
+        pthread_join((*reload)->thread, NULL);
+
+        free(*reload);
+        *reload = NULL;
+    }
+}
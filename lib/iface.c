@@ -0,0 +1,200 @@
+#include "iface.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+/**
+ * @brief Reads the addresses of an interface from the kernel.
+ *
+ * @param iface receives the name, index, MAC and IPv4 addresses and the MTU
+ * @param name the name of the interface
+ * @param fd any socket that can query the interface
+ * @return int 0 on success or -1 if the interface can not be queried.
+ */
+int iface_init(iface_t *__restrict__ iface, const char *name, int fd) {
+    if ((iface == NULL) || (name == NULL) || (strlen(name) >= IFNAMSIZ)) {
+        return -1;
+    }
+
+    struct ifreq ifr;
+
+    memset(iface, 0, sizeof *iface);
+    strcpy(iface->name, name);
+
+    memset(&ifr, 0, sizeof ifr);
+    strcpy(ifr.ifr_name, name);
+
+    if (ioctl(fd, SIOCGIFINDEX, &ifr) == -1) {
+        return -1;
+    }
+
+    iface->ifindex = ifr.ifr_ifindex;
+
+    if (ioctl(fd, SIOCGIFHWADDR, &ifr) == -1) {
+        return -1;
+    }
+
+    memcpy(iface->mac, ifr.ifr_hwaddr.sa_data, IFACE_MAC_SIZE);
+
+    if (ioctl(fd, SIOCGIFMTU, &ifr) == -1) {
+        return -1;
+    }
+
+    iface->mtu = (uint32_t)ifr.ifr_mtu;
+
+    /* An interface without an address gets one later from the netlink events */
+    ifr.ifr_addr.sa_family = AF_INET;
+
+    if (ioctl(fd, SIOCGIFADDR, &ifr) == 0) {
+        iface->ipv4 = ((struct sockaddr_in *)&ifr.ifr_addr)->sin_addr.s_addr;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Opens a netlink socket subscribed to the link and IPv4 address
+ * events. The socket does not block, so it is drained after it becomes
+ * readable.
+ *
+ * @return int the socket or -1 on failure.
+ */
+int iface_netlink_open(void) {
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+
+    if (fd == -1) {
+        return -1;
+    }
+
+    struct sockaddr_nl addr;
+
+    memset(&addr, 0, sizeof addr);
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR;
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof addr) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void iface_write_begin(iface_t *__restrict__ iface) {
+    atomic_fetch_add_explicit(&iface->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void iface_write_end(iface_t *__restrict__ iface) {
+    atomic_fetch_add_explicit(&iface->seq, 1, memory_order_release);
+}
+
+static iface_t* iface_find(iface_t *__restrict__ ifaces, size_t len, int ifindex) {
+    for (size_t iter = 0; iter < len; ++iter) {
+        if (ifaces[iter].ifindex == ifindex) {
+            return ifaces + iter;
+        }
+    }
+
+    return NULL;
+}
+
+static void iface_link_event(iface_t *__restrict__ iface, const struct nlmsghdr *msg) {
+    const struct ifinfomsg *info = NLMSG_DATA(msg);
+    int attrs_len = (int)IFLA_PAYLOAD(msg);
+
+    for (const struct rtattr *attr = IFLA_RTA(info); RTA_OK(attr, attrs_len); attr = RTA_NEXT(attr, attrs_len)) {
+        if ((attr->rta_type == IFLA_ADDRESS) && (RTA_PAYLOAD(attr) == IFACE_MAC_SIZE)) {
+            memcpy(iface->mac, RTA_DATA(attr), IFACE_MAC_SIZE);
+        } else if ((attr->rta_type == IFLA_MTU) && (RTA_PAYLOAD(attr) == sizeof(uint32_t))) {
+            memcpy(&iface->mtu, RTA_DATA(attr), sizeof(uint32_t));
+        } else if ((attr->rta_type == IFLA_IFNAME) && (RTA_PAYLOAD(attr) <= IFNAMSIZ)) {
+            strncpy(iface->name, RTA_DATA(attr), IFNAMSIZ - 1);
+        }
+    }
+}
+
+static void iface_addr_event(iface_t *__restrict__ iface, const struct nlmsghdr *msg) {
+    const struct ifaddrmsg *info = NLMSG_DATA(msg);
+    int attrs_len = (int)IFA_PAYLOAD(msg);
+    uint32_t addr = 0;
+
+    for (const struct rtattr *attr = IFA_RTA(info); RTA_OK(attr, attrs_len); attr = RTA_NEXT(attr, attrs_len)) {
+
+        /* The local address is the one of the interface, the address is the peer on point to point links */
+        if (((attr->rta_type == IFA_LOCAL) || ((attr->rta_type == IFA_ADDRESS) && (addr == 0))) &&
+            (RTA_PAYLOAD(attr) == sizeof(uint32_t))) {
+            memcpy(&addr, RTA_DATA(attr), sizeof(uint32_t));
+        }
+    }
+
+    if (msg->nlmsg_type == RTM_NEWADDR) {
+        iface->ipv4 = addr;
+    } else if (iface->ipv4 == addr) {
+        iface->ipv4 = 0;
+    }
+}
+
+/**
+ * @brief Applies the pending netlink events to the interfaces they
+ * name, the events of other interfaces are skipped.
+ *
+ * @param fd the netlink socket
+ * @param ifaces the interfaces of the router
+ * @param len the number of interfaces
+ * @return int the number of events applied or -1 if the socket failed.
+ */
+int iface_netlink_process(int fd, iface_t *__restrict__ ifaces, size_t len) {
+    char buf[IFACE_NETLINK_BUF_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+    int applied = 0;
+
+    while (1) {
+        ssize_t ret = recv(fd, buf, sizeof buf, 0);
+
+        if (ret == -1) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return applied;
+            }
+
+            /* The kernel dropped events, the next ones still apply */
+            if ((errno == EINTR) || (errno == ENOBUFS)) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        int msg_len = (int)ret;
+
+        for (struct nlmsghdr *msg = (struct nlmsghdr *)buf; NLMSG_OK(msg, msg_len); msg = NLMSG_NEXT(msg, msg_len)) {
+            iface_t *iface = NULL;
+
+            if ((msg->nlmsg_type == RTM_NEWLINK) && (msg->nlmsg_len >= NLMSG_LENGTH(sizeof(struct ifinfomsg)))) {
+                iface = iface_find(ifaces, len, ((struct ifinfomsg *)NLMSG_DATA(msg))->ifi_index);
+
+                if (iface != NULL) {
+                    iface_write_begin(iface);
+                    iface_link_event(iface, msg);
+                    iface_write_end(iface);
+                }
+            } else if (((msg->nlmsg_type == RTM_NEWADDR) || (msg->nlmsg_type == RTM_DELADDR)) &&
+                       (msg->nlmsg_len >= NLMSG_LENGTH(sizeof(struct ifaddrmsg))) &&
+                       (((struct ifaddrmsg *)NLMSG_DATA(msg))->ifa_family == AF_INET)) {
+                iface = iface_find(ifaces, len, (int)((struct ifaddrmsg *)NLMSG_DATA(msg))->ifa_index);
+
+                if (iface != NULL) {
+                    iface_write_begin(iface);
+                    iface_addr_event(iface, msg);
+                    iface_write_end(iface);
+                }
+            }
+
+            applied += (iface != NULL);
+        }
+    }
+}
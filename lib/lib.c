@@ -1,4 +1,10 @@
+#define _GNU_SOURCE
+
 #include "lib.h"
+#include "rtable.h"
+#include "iface.h"
+#include "packet_ring.h"
+#include "csum.h"
 
 #include <sys/ioctl.h>
 #include <net/if.h>
@@ -17,9 +23,49 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
-
-
-int interfaces[ROUTER_NUM_INTERFACES];
+#include <errno.h>
+#include <sys/epoll.h>
+
+
+iface_t *interfaces;
+int interfaces_len;
+static char **interface_names;
+
+/* The netlink socket is served by the thread that opens its links with LINKS_NETLINK */
+static int netlink_fd = -1;
+#define EPOLL_NETLINK UINT32_MAX
+#define EPOLL_EVENT (UINT32_MAX - 1)
+
+/* The frames queued for an interface, sent together by flush_link */
+struct tx_queue {
+	struct mmsghdr msgs[BURST_SIZE];
+	struct iovec iovs[BURST_SIZE];
+	unsigned int len;
+};
+
+/*
+ * The sockets of a forwarding thread, every thread opens its own
+ * socket or rings on every interface. Every socket is watched edge
+ * triggered, the interfaces that may still have frames are kept in
+ * the order they are drained: an edge triggered socket reports new
+ * frames just once, so an interface stays there until a read finds
+ * it empty.
+ */
+struct links {
+	int backend;
+	int epoll_fd;
+	int event_fd;
+	int *fds;
+	packet_ring_t *rings;
+	struct tx_queue *tx_queues;
+	int *rx_ready;
+	char *rx_is_ready;
+	int rx_head, rx_count;
+};
+static __thread struct links *links;
+
+/* The sockets read and written directly or the PACKET_MMAP rings of the forwarding threads */
+static int io_backend = IO_BACKEND_SOCKET;
 
 int get_sock(const char *if_name)
 {
@@ -49,7 +95,14 @@ int send_to_link(int intidx, char *frame_data, size_t len)
 	 * interface, eg 1500 bytes 
 	 */
 	int ret;
-	ret = write(interfaces[intidx], frame_data, len);
+
+	if (links->backend == IO_BACKEND_RING) {
+		ret = packet_ring_send(&links->rings[intidx], frame_data, len);
+		DIE(ret == -1 || packet_ring_flush(&links->rings[intidx]) == -1, "packet_ring_send");
+		return len;
+	}
+
+	ret = write(links->fds[intidx], frame_data, len);
 	DIE(ret == -1, "write");
 	return ret;
 }
@@ -57,7 +110,7 @@ int send_to_link(int intidx, char *frame_data, size_t len)
 ssize_t receive_from_link(int intidx, char *frame_data)
 {
 	ssize_t ret;
-	ret = read(interfaces[intidx], frame_data, MAX_PACKET_LEN);
+	ret = read(links->fds[intidx], frame_data, MAX_PACKET_LEN);
 	return ret;
 }
 
@@ -74,71 +127,253 @@ int socket_receive_message(int sockfd, char *frame_data, size_t *len)
 }
 
 int recv_from_any_link(char *frame_data, size_t *length) {
+	return recv_from_any_link_timeout(frame_data, length, -1);
+}
+
+static void mark_ready(int interface)
+{
+	if (!links->rx_is_ready[interface]) {
+		links->rx_is_ready[interface] = 1;
+		links->rx_ready[(links->rx_head + links->rx_count) % interfaces_len] = interface;
+		links->rx_count++;
+	}
+}
+
+static void wait_any_link(int timeout_ms)
+{
+	struct epoll_event events[BURST_SIZE];
 	int res;
-	fd_set set;
 
-	FD_ZERO(&set);
-	while (1) {
-		for (int i = 0; i < ROUTER_NUM_INTERFACES; i++) {
-			FD_SET(interfaces[i], &set);
+	/* The interfaces that are not drained yet are served without waiting */
+	if (links->rx_count != 0)
+		timeout_ms = 0;
+
+	do {
+		res = epoll_wait(links->epoll_fd, events, BURST_SIZE, timeout_ms);
+	} while (res == -1 && errno == EINTR);
+	DIE(res == -1, "epoll_wait");
+
+	for (int i = 0; i < res; i++) {
+		if (events[i].data.u32 == EPOLL_NETLINK) {
+			/* Keep the cached addresses up to date */
+			int ret = iface_netlink_process(netlink_fd, interfaces, interfaces_len);
+			DIE(ret == -1, "netlink");
+		} else {
+			mark_ready(events[i].data.u32);
 		}
+	}
+}
+
+static size_t recv_from_ready_link(int interface, struct frame *frames, size_t count, int *drained)
+{
+	if (links->backend == IO_BACKEND_RING) {
+		char *datas[BURST_SIZE];
+		size_t lens[BURST_SIZE];
+		size_t ret = packet_ring_recv(&links->rings[interface], datas, lens, count);
+
+		for (size_t j = 0; j < ret; j++) {
+			frames[j].data = datas[j];
+			frames[j].len = lens[j];
+			frames[j].interface = interface;
+		}
+
+		*drained = !packet_ring_ready(&links->rings[interface]);
+		return ret;
+	}
+
+	struct mmsghdr msgs[BURST_SIZE];
+	struct iovec iovs[BURST_SIZE];
+
+	memset(msgs, 0, sizeof(msgs[0]) * count);
+	for (size_t j = 0; j < count; j++) {
+		iovs[j].iov_base = frames[j].data;
+		iovs[j].iov_len = MAX_PACKET_LEN;
+		msgs[j].msg_hdr.msg_iov = &iovs[j];
+		msgs[j].msg_hdr.msg_iovlen = 1;
+	}
+
+	int ret = recvmmsg(links->fds[interface], msgs, count, MSG_DONTWAIT, NULL);
+	if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		*drained = 1;
+		return 0;
+	}
+	if (ret == -1 && errno == EINTR) {
+		*drained = 0;
+		return 0;
+	}
+	DIE(ret == -1, "recvmmsg");
+
+	for (int j = 0; j < ret; j++) {
+		frames[j].len = msgs[j].msg_len;
+		frames[j].interface = interface;
+	}
+
+	/* A short read emptied the socket, the next frames come with a new edge */
+	*drained = (size_t)ret < count;
+	return ret;
+}
+
+int recv_burst_from_any_link(struct frame *frames, size_t count, int timeout_ms)
+{
+	size_t len = 0;
+
+	if (count > BURST_SIZE)
+		count = BURST_SIZE;
+
+	while (len == 0) {
+		wait_any_link(timeout_ms);
+
+		if (links->rx_count == 0)
+			return RECV_TIMEOUT;
+
+		/* Every ready interface gets an equal share of the burst, round robin */
+		size_t share = count / links->rx_count;
+		if (share == 0)
+			share = 1;
 
-		res = select(interfaces[ROUTER_NUM_INTERFACES - 1] + 1, &set, NULL, NULL, NULL);
-		DIE(res == -1, "select");
+		for (int k = links->rx_count; k > 0 && len < count; k--) {
+			int interface = links->rx_ready[links->rx_head];
+			int drained;
+			size_t want = (count - len < share) ? count - len : share;
 
-		for (int i = 0; i < ROUTER_NUM_INTERFACES; i++) {
-			if (FD_ISSET(interfaces[i], &set)) {
-				ssize_t ret = receive_from_link(i, frame_data);
-				DIE(ret < 0, "receive_from_link");
-				*length = ret;
-				return i;
-			}
+			links->rx_head = (links->rx_head + 1) % interfaces_len;
+			links->rx_count--;
+
+			len += recv_from_ready_link(interface, frames + len, want, &drained);
+
+			/* An interface that still has frames goes to the back of the line */
+			links->rx_is_ready[interface] = 0;
+			if (!drained)
+				mark_ready(interface);
 		}
 	}
 
-	return -1;
+	return (int)len;
 }
 
-char *get_interface_ip(int interface)
+int recv_from_any_link_timeout(char *frame_data, size_t *length, int timeout_ms) {
+	struct frame frame = { .data = frame_data };
+
+	if (recv_burst_from_any_link(&frame, 1, timeout_ms) == RECV_TIMEOUT)
+		return RECV_TIMEOUT;
+
+	/* The ring frames are copied, just the bursts are read in place */
+	if (frame.data != frame_data)
+		memcpy(frame_data, frame.data, frame.len);
+
+	*length = frame.len;
+	return frame.interface;
+}
+
+void send_to_link_burst(int interface, char *frame_data, size_t length)
 {
-	struct ifreq ifr;
-	int ret;
-	if (interface == 0)
-		sprintf(ifr.ifr_name, "rr-0-1");
-	else {
-		sprintf(ifr.ifr_name, "r-%u", interface - 1);
+	struct tx_queue *queue = &links->tx_queues[interface];
+	unsigned int j = queue->len;
+
+	/* The ring slots get a copy of the frame, so the frame can change right away */
+	if (links->backend == IO_BACKEND_RING) {
+		if (packet_ring_send(&links->rings[interface], frame_data, length) == 0 && ++queue->len == BURST_SIZE)
+			flush_link(interface);
+		return;
 	}
-	ret = ioctl(interfaces[interface], SIOCGIFADDR, &ifr);
-	DIE(ret == -1, "ioctl SIOCGIFADDR");
-	return inet_ntoa(((struct sockaddr_in *)&ifr.ifr_addr)->sin_addr);
+
+	queue->iovs[j].iov_base = frame_data;
+	queue->iovs[j].iov_len = length;
+	memset(&queue->msgs[j], 0, sizeof(queue->msgs[j]));
+	queue->msgs[j].msg_hdr.msg_iov = &queue->iovs[j];
+	queue->msgs[j].msg_hdr.msg_iovlen = 1;
+
+	if (++queue->len == BURST_SIZE)
+		flush_link(interface);
 }
 
-uint32_t get_interface_ipv4(int interface)
+void flush_link(int interface)
 {
-	struct ifreq ifr;
-	int ret;
-	if (interface == 0)
-		sprintf(ifr.ifr_name, "rr-0-1");
-	else {
-		sprintf(ifr.ifr_name, "r-%u", interface - 1);
+	struct tx_queue *queue = &links->tx_queues[interface];
+	unsigned int sent = 0;
+
+	if (links->backend == IO_BACKEND_RING) {
+		DIE(packet_ring_flush(&links->rings[interface]) == -1, "packet_ring_flush");
+		queue->len = 0;
+		return;
+	}
+
+	while (sent < queue->len) {
+		int ret = sendmmsg(links->fds[interface], queue->msgs + sent, queue->len - sent, 0);
+		if (ret == -1 && errno == EINTR)
+			continue;
+		DIE(ret == -1, "sendmmsg");
+		sent += ret;
 	}
-	ret = ioctl(interfaces[interface], SIOCGIFADDR, &ifr);
-	DIE(ret == -1, "ioctl SIOCGIFADDR");
-	return ((struct sockaddr_in *)&ifr.ifr_addr)->sin_addr.s_addr;
+
+	queue->len = 0;
 }
 
-void get_interface_mac(int interface, uint8_t *mac)
+void flush_links(void)
 {
-	struct ifreq ifr;
-	int ret;
-	if (interface == 0)
-		sprintf(ifr.ifr_name, "rr-0-1");
-	else {
-		sprintf(ifr.ifr_name, "r-%u", interface - 1);
+	for (int i = 0; i < interfaces_len; i++) {
+		if (links->tx_queues[i].len != 0)
+			flush_link(i);
 	}
-	ret = ioctl(interfaces[interface], SIOCGIFHWADDR, &ifr);
-	DIE(ret == -1, "ioctl SIOCGIFHWADDR");
-	memcpy(mac, ifr.ifr_addr.sa_data, 6);
+}
+
+int wait_event(int fd, int timeout_ms)
+{
+	struct epoll_event events[2];
+	int res, ready = 0;
+
+	if (links->event_fd != fd) {
+		struct epoll_event event = { .events = EPOLLIN, .data.u32 = EPOLL_EVENT };
+
+		res = epoll_ctl(links->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+		DIE(res == -1, "epoll_ctl event");
+		links->event_fd = fd;
+	}
+
+	do {
+		res = epoll_wait(links->epoll_fd, events, 2, timeout_ms);
+	} while (res == -1 && errno == EINTR);
+	DIE(res == -1, "epoll_wait");
+
+	for (int i = 0; i < res; i++) {
+		if (events[i].data.u32 == EPOLL_NETLINK) {
+			int ret = iface_netlink_process(netlink_fd, interfaces, interfaces_len);
+			DIE(ret == -1, "netlink");
+
+			if (ret != 0)
+				ready |= WAIT_NETLINK;
+		} else if (events[i].data.u32 == EPOLL_EVENT) {
+			ready |= WAIT_EVENT;
+		}
+	}
+
+	return ready;
+}
+
+int get_num_interfaces(void)
+{
+	return interfaces_len;
+}
+
+char *get_interface_ip(int interface)
+{
+	struct in_addr addr;
+
+	iface_read(&interfaces[interface], NULL, &addr.s_addr);
+	return inet_ntoa(addr);
+}
+
+uint32_t get_interface_ipv4(int interface)
+{
+	uint32_t ipv4;
+
+	iface_read(&interfaces[interface], NULL, &ipv4);
+	return ipv4;
+}
+
+void get_interface_mac(int interface, uint8_t *mac)
+{
+	iface_read(&interfaces[interface], mac, NULL);
 }
 
 static int hex2num(char c)
@@ -186,58 +421,123 @@ int hwaddr_aton(const char *txt, uint8_t *addr)
 
 void init(int argc, char *argv[])
 {
+	init_backend(argc, argv, IO_BACKEND_SOCKET);
+	init_links(LINKS_NETLINK);
+}
+
+void init_backend(int argc, char *argv[], int backend)
+{
+	int res, fd;
+
+	io_backend = backend;
+	interfaces_len = argc;
+	interface_names = argv;
+
+	interfaces = calloc(argc, sizeof(*interfaces));
+	DIE(interfaces == NULL, "calloc");
+
+	/* The addresses are read once, then the netlink events refresh them */
+	fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	DIE(fd == -1, "socket");
+
 	for (int i = 0; i < argc; ++i) {
 		printf("Setting up interface: %s\n", argv[i]);
-		interfaces[i] = get_sock(argv[i]);
+		res = iface_init(&interfaces[i], argv[i], fd);
+		DIE(res == -1, "ioctl %s", argv[i]);
 	}
-}
 
+	close(fd);
 
-uint16_t checksum(uint16_t *data, size_t len)
+	netlink_fd = iface_netlink_open();
+	DIE(netlink_fd == -1, "netlink");
+}
+
+void init_links(int flags)
 {
-	unsigned long checksum = 0;
-	uint16_t extra_byte;
-	while (len > 1) {
-		checksum += ntohs(*data++);
-		len -= 2;
+	struct epoll_event event;
+	int res;
+
+	links = calloc(1, sizeof(*links));
+	DIE(links == NULL, "calloc");
+
+	links->fds = calloc(interfaces_len, sizeof(*links->fds));
+	links->rings = calloc(interfaces_len, sizeof(*links->rings));
+	links->tx_queues = calloc(interfaces_len, sizeof(*links->tx_queues));
+	links->rx_ready = calloc(interfaces_len, sizeof(*links->rx_ready));
+	links->rx_is_ready = calloc(interfaces_len, sizeof(*links->rx_is_ready));
+	DIE(!links->fds || !links->rings || !links->tx_queues || !links->rx_ready || !links->rx_is_ready, "calloc");
+
+	links->backend = (flags & LINKS_SEND) ? IO_BACKEND_SOCKET : io_backend;
+	links->event_fd = -1;
+	links->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	DIE(links->epoll_fd == -1, "epoll_create1");
+
+	for (int i = 0; i < interfaces_len; ++i) {
+		if (flags & LINKS_SEND) {
+			/* A socket without a protocol receives nothing, it just sends */
+			links->fds[i] = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+			DIE(links->fds[i] == -1, "socket");
+
+			struct sockaddr_ll addr = {
+				.sll_family = AF_PACKET,
+				.sll_ifindex = interfaces[i].ifindex
+			};
+
+			res = bind(links->fds[i], (struct sockaddr *)&addr, sizeof(addr));
+			DIE(res == -1, "bind");
+			continue;
+		}
+
+		if (links->backend == IO_BACKEND_RING) {
+			res = packet_ring_open(&links->rings[i], interface_names[i]);
+			DIE(res == -1, "packet ring %s", interface_names[i]);
+			links->fds[i] = links->rings[i].rx_fd;
+		} else {
+			links->fds[i] = get_sock(interface_names[i]);
+		}
+
+		/* The threads share the frames of an interface by the hash of their flow */
+		if (flags & LINKS_FANOUT) {
+			int group = ((getpid() + i) & 0xffff) | (PACKET_FANOUT_HASH << 16);
+
+			res = setsockopt(links->fds[i], SOL_PACKET, PACKET_FANOUT, &group, sizeof(group));
+			DIE(res == -1, "PACKET_FANOUT %s", interface_names[i]);
+		}
+
+		/* The frames that came before the socket was watched are drained first */
+		event.events = EPOLLIN | EPOLLET;
+		event.data.u32 = i;
+		res = epoll_ctl(links->epoll_fd, EPOLL_CTL_ADD, links->fds[i], &event);
+		DIE(res == -1, "epoll_ctl %s", interface_names[i]);
+		mark_ready(i);
 	}
-	if (len) {
-		*(uint8_t *)&extra_byte = *(uint8_t *)data;
-		checksum += extra_byte;
+
+	if (flags & LINKS_NETLINK) {
+		event.events = EPOLLIN;
+		event.data.u32 = EPOLL_NETLINK;
+		res = epoll_ctl(links->epoll_fd, EPOLL_CTL_ADD, netlink_fd, &event);
+		DIE(res == -1, "epoll_ctl netlink");
 	}
+}
 
-	checksum = (checksum >> 16) + (checksum & 0xffff);
-	checksum += (checksum >>16);
-	return (uint16_t)(~checksum);
+uint16_t checksum(uint16_t *data, size_t len)
+{
+	/* The sum is taken in memory order, the checksum is still returned in host order */
+	return ntohs(csum_fold(csum_partial(data, len, 0)));
 }
 
 int read_rtable(const char *path, struct route_table_entry *rtable)
 {
-	FILE *fp = fopen(path, "r");
-	int j = 0, i;
-	char *p, line[64];
-
-	while (fgets(line, sizeof(line), fp) != NULL) {
-		p = strtok(line, " .");
-		i = 0;
-		while (p != NULL) {
-			if (i < 4)
-				*(((unsigned char *)&rtable[j].prefix)  + i % 4) = (unsigned char)atoi(p);
-
-			if (i >= 4 && i < 8)
-				*(((unsigned char *)&rtable[j].next_hop)  + i % 4) = atoi(p);
-
-			if (i >= 8 && i < 12)
-				*(((unsigned char *)&rtable[j].mask)  + i % 4) = atoi(p);
-
-			if (i == 12)
-				rtable[j].interface = atoi(p);
-			p = strtok(NULL, " .");
-			i++;
-		}
-		j++;
-	}
-	return j;
+	rtable_t *table = rtable_parse(path, 0);
+	int len;
+
+	DIE(table == NULL, "Failed to read %s", path);
+
+	memcpy(rtable, table->routes, sizeof(*rtable) * table->len);
+	len = (int)table->len;
+
+	free_rtable(&table);
+	return len;
 }
 
 int parse_arp_table(char *path, struct arp_entry *arp_table)
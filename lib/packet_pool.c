@@ -0,0 +1,56 @@
+#include "packet_pool.h"
+
+/**
+ * @brief Create a packet pool object.
+ *
+ * @param count the number of buffers
+ * @param size the size of a buffer in bytes
+ * @return packet_pool_t* returns a pool with every buffer free or NULL on failure.
+ */
+packet_pool_t* create_packet_pool(uint32_t count, size_t size) {
+    if ((count == 0) || (count > PACKET_POOL_MAX_SIZE) || (size == 0)) {
+        return NULL;
+    }
+
+    packet_pool_t *new_pool = malloc(sizeof *new_pool);
+
+    if (new_pool != NULL) {
+        if (size < sizeof(packet_pool_free_t)) {
+            size = sizeof(packet_pool_free_t);
+        }
+
+        new_pool->stride = (size + PACKET_POOL_ALIGN - 1) & ~((size_t)PACKET_POOL_ALIGN - 1);
+        new_pool->memory = aligned_alloc(PACKET_POOL_ALIGN, new_pool->stride * count);
+
+        if (new_pool->memory == NULL) {
+            free(new_pool);
+            return NULL;
+        }
+
+        new_pool->count = count;
+        new_pool->available = 0;
+        new_pool->free = NULL;
+
+        /* Link the buffers backwards, so the first allocations take the first buffers */
+        for (uint32_t iter = count; iter > 0; --iter) {
+            packet_pool_release(new_pool, new_pool->memory + (size_t)(iter - 1) * new_pool->stride);
+        }
+    }
+
+    return new_pool;
+}
+
+/**
+ * @brief Frees the memory allocated for the pool, the buffers
+ * taken from it become invalid.
+ *
+ * @param pool a pointer to the packet pool.
+ */
+void free_packet_pool(packet_pool_t **__restrict__ pool) {
+    if ((pool != NULL) && (*pool != NULL)) {
+        free((*pool)->memory);
+
+        free(*pool);
+        *pool = NULL;
+    }
+}
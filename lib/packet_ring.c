@@ -0,0 +1,287 @@
+#include "packet_ring.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+
+static int packet_ring_socket(const char *name, int protocol, int version, int ring, const void *req, socklen_t req_len) {
+    int fd = socket(AF_PACKET, SOCK_RAW, protocol);
+
+    if (fd == -1) {
+        return -1;
+    }
+
+    struct sockaddr_ll addr;
+
+    memset(&addr, 0, sizeof addr);
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = (uint16_t)protocol;
+    addr.sll_ifindex = (int)if_nametoindex(name);
+
+    if ((addr.sll_ifindex == 0) ||
+        (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof version) == -1) ||
+        (setsockopt(fd, SOL_PACKET, ring, req, req_len) == -1) ||
+        (bind(fd, (struct sockaddr *)&addr, sizeof addr) == -1)) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Opens the receive and the send rings of an interface.
+ *
+ * @param ring receives the mapped rings
+ * @param name the name of the interface
+ * @return int 0 on success or -1 if a ring can not be set up.
+ */
+int packet_ring_open(packet_ring_t *__restrict__ ring, const char *name) {
+    if ((ring == NULL) || (name == NULL)) {
+        return -1;
+    }
+
+    struct tpacket_req3 rx_req;
+    struct tpacket_req tx_req;
+
+    memset(ring, 0, sizeof *ring);
+    ring->tx_fd = -1;
+
+    memset(&rx_req, 0, sizeof rx_req);
+    rx_req.tp_block_size = PACKET_RING_BLOCK_SIZE;
+    rx_req.tp_block_nr = PACKET_RING_BLOCK_COUNT;
+    rx_req.tp_frame_size = PACKET_RING_FRAME_SIZE;
+    rx_req.tp_frame_nr = (PACKET_RING_BLOCK_SIZE / PACKET_RING_FRAME_SIZE) * PACKET_RING_BLOCK_COUNT;
+    rx_req.tp_retire_blk_tov = PACKET_RING_RETIRE_MS;
+
+    ring->rx_fd = packet_ring_socket(name, htons(ETH_P_ALL), TPACKET_V3, PACKET_RX_RING, &rx_req, sizeof rx_req);
+
+    if (ring->rx_fd == -1) {
+        return -1;
+    }
+
+    /* The frames sent from the other ring must not come back as received frames */
+    int ignore = 1;
+    setsockopt(ring->rx_fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &ignore, sizeof ignore);
+
+    ring->rx_size = (size_t)rx_req.tp_block_size * rx_req.tp_block_nr;
+    ring->rx_map = mmap(NULL, ring->rx_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->rx_fd, 0);
+
+    if (ring->rx_map == MAP_FAILED) {
+        ring->rx_map = NULL;
+        packet_ring_close(ring);
+        return -1;
+    }
+
+    memset(&tx_req, 0, sizeof tx_req);
+    tx_req.tp_block_size = PACKET_RING_FRAME_SIZE * (PACKET_RING_TX_FRAMES / 8);
+    tx_req.tp_block_nr = 8;
+    tx_req.tp_frame_size = PACKET_RING_FRAME_SIZE;
+    tx_req.tp_frame_nr = PACKET_RING_TX_FRAMES;
+
+    /* The protocol 0 socket sends on the interface without receiving anything */
+    ring->tx_fd = packet_ring_socket(name, 0, TPACKET_V2, PACKET_TX_RING, &tx_req, sizeof tx_req);
+
+    if (ring->tx_fd == -1) {
+        packet_ring_close(ring);
+        return -1;
+    }
+
+    ring->tx_size = (size_t)tx_req.tp_block_size * tx_req.tp_block_nr;
+    ring->tx_map = mmap(NULL, ring->tx_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->tx_fd, 0);
+
+    if (ring->tx_map == MAP_FAILED) {
+        ring->tx_map = NULL;
+        packet_ring_close(ring);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Unmaps the rings and closes their sockets.
+ *
+ * @param ring the rings of an interface
+ */
+void packet_ring_close(packet_ring_t *__restrict__ ring) {
+    if (ring != NULL) {
+        if (ring->rx_map != NULL) {
+            munmap(ring->rx_map, ring->rx_size);
+        }
+
+        if (ring->tx_map != NULL) {
+            munmap(ring->tx_map, ring->tx_size);
+        }
+
+        if (ring->rx_fd != -1) {
+            close(ring->rx_fd);
+        }
+
+        if (ring->tx_fd != -1) {
+            close(ring->tx_fd);
+        }
+
+        memset(ring, 0, sizeof *ring);
+        ring->rx_fd = -1;
+        ring->tx_fd = -1;
+    }
+}
+
+static struct tpacket_block_desc* packet_ring_block(const packet_ring_t *__restrict__ ring) {
+    return (struct tpacket_block_desc *)(ring->rx_map + (size_t)ring->rx_block * PACKET_RING_BLOCK_SIZE);
+}
+
+/**
+ * @brief Gives back to the kernel the block that was read entirely.
+ * The frames of the block are rewritten and sent in place, so the
+ * block is released only after the burst that read it was sent.
+ *
+ * @param ring the rings of an interface
+ */
+void packet_ring_release(packet_ring_t *__restrict__ ring) {
+    if ((ring != NULL) && (ring->rx_frame != NULL) && (ring->rx_left == 0)) {
+        struct tpacket_block_desc *block = packet_ring_block(ring);
+
+        __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+
+        ring->rx_frame = NULL;
+        ring->rx_block = (ring->rx_block + 1) % PACKET_RING_BLOCK_COUNT;
+    }
+}
+
+/**
+ * @brief Reads the next frames of the receive ring without copying
+ * them, a single block is read at a time.
+ *
+ * @param ring the rings of an interface
+ * @param frames receives pointers to the frames, valid until the block is released
+ * @param lens receives the lengths of the frames
+ * @param count the most frames read
+ * @return size_t the number of frames read, 0 if no block is ready.
+ */
+size_t packet_ring_recv(packet_ring_t *__restrict__ ring, char **frames, size_t *lens, size_t count) {
+    size_t len = 0;
+
+    packet_ring_release(ring);
+
+    if (ring->rx_frame == NULL) {
+        struct tpacket_block_desc *block = packet_ring_block(ring);
+
+        if ((__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0) {
+            return 0;
+        }
+
+        ring->rx_left = block->hdr.bh1.num_pkts;
+        ring->rx_frame = (struct tpacket3_hdr *)((uint8_t *)block + block->hdr.bh1.offset_to_first_pkt);
+    }
+
+    while ((len < count) && (ring->rx_left > 0)) {
+        struct tpacket3_hdr *frame = ring->rx_frame;
+        const struct sockaddr_ll *addr = (const struct sockaddr_ll *)((uint8_t *)frame + TPACKET_ALIGN(sizeof *frame));
+
+        if (addr->sll_pkttype != PACKET_OUTGOING) {
+            frames[len] = (char *)frame + frame->tp_mac;
+            lens[len] = frame->tp_snaplen;
+            ++len;
+        }
+
+        ring->rx_frame = (struct tpacket3_hdr *)((uint8_t *)frame + frame->tp_next_offset);
+        --(ring->rx_left);
+    }
+
+    return len;
+}
+
+/**
+ * @brief Checks if the receive ring has frames that were not read,
+ * without giving back the block that is read.
+ *
+ * @param ring the rings of an interface
+ * @return int 1 if a frame is ready or 0 otherwise.
+ */
+int packet_ring_ready(const packet_ring_t *__restrict__ ring) {
+    uint32_t block = ring->rx_block;
+
+    if (ring->rx_frame != NULL) {
+        if (ring->rx_left > 0) {
+            return 1;
+        }
+
+        block = (block + 1) % PACKET_RING_BLOCK_COUNT;
+    }
+
+    const struct tpacket_block_desc *desc =
+        (const struct tpacket_block_desc *)(ring->rx_map + (size_t)block * PACKET_RING_BLOCK_SIZE);
+
+    return (__atomic_load_n(&desc->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) != 0;
+}
+
+/**
+ * @brief Copies a frame in the next free slot of the send ring, the
+ * frame is sent by the next flush.
+ *
+ * @param ring the rings of an interface
+ * @param frame the frame to send
+ * @param len the length of the frame
+ * @return int 0 if the frame was queued or -1 if it was dropped.
+ */
+int packet_ring_send(packet_ring_t *__restrict__ ring, const char *frame, size_t len) {
+    const size_t offset = TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+
+    if (len > PACKET_RING_FRAME_SIZE - offset) {
+        return -1;
+    }
+
+    struct tpacket2_hdr *slot = (struct tpacket2_hdr *)(ring->tx_map + (size_t)ring->tx_head * PACKET_RING_FRAME_SIZE);
+
+    /* A full ring is kicked once, a frame that still finds no free slot is dropped */
+    if ((__atomic_load_n(&slot->tp_status, __ATOMIC_ACQUIRE) & (TP_STATUS_SEND_REQUEST | TP_STATUS_SENDING)) != 0) {
+        if ((packet_ring_flush(ring) == -1) ||
+            ((__atomic_load_n(&slot->tp_status, __ATOMIC_ACQUIRE) & (TP_STATUS_SEND_REQUEST | TP_STATUS_SENDING)) != 0)) {
+            return -1;
+        }
+    }
+
+    memcpy((uint8_t *)slot + offset, frame, len);
+    slot->tp_len = (uint32_t)len;
+    __atomic_store_n(&slot->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+
+    ring->tx_head = (ring->tx_head + 1) % PACKET_RING_TX_FRAMES;
+    ++(ring->tx_pending);
+
+    return 0;
+}
+
+/**
+ * @brief Asks the kernel to send the frames queued in the send ring.
+ *
+ * @param ring the rings of an interface
+ * @return int 0 on success or -1 if the kernel refused the frames.
+ */
+int packet_ring_flush(packet_ring_t *__restrict__ ring) {
+    if (ring->tx_pending == 0) {
+        return 0;
+    }
+
+    while (send(ring->tx_fd, NULL, 0, MSG_DONTWAIT) == -1) {
+
+        /* The frames the device could not take yet stay queued for the next flush */
+        if ((errno == EAGAIN) || (errno == ENOBUFS)) {
+            return 0;
+        }
+
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+
+    ring->tx_pending = 0;
+
+    return 0;
+}
@@ -0,0 +1,283 @@
+#include "poptrie.h"
+
+#include <arpa/inet.h>
+
+/**
+ * @brief Frees the memory allocated for the poptrie.
+ *
+ * @param trie a pointer to the poptrie.
+ */
+void free_poptrie(poptrie_t **__restrict__ trie) {
+    if ((trie != NULL) && (*trie != NULL)) {
+        free((*trie)->direct);
+        free((*trie)->nodes);
+        free((*trie)->leaves);
+        free((*trie)->hops);
+
+        free(*trie);
+        *trie = NULL;
+    }
+}
+
+static inline uint32_t poptrie_chunk(uint32_t key, uint32_t offset) {
+
+    /* The last chunk goes past the 32 bits of the address, so it is padded with zeros */
+    if (offset + POPTRIE_STRIDE <= 32) {
+        return (key >> (32 - POPTRIE_STRIDE - offset)) & (POPTRIE_FANOUT - 1);
+    }
+
+    return (key << (offset + POPTRIE_STRIDE - 32)) & (POPTRIE_FANOUT - 1);
+}
+
+/**
+ * @brief Computes the longest prefix match, after the direct pointing
+ * every step takes 6 bits of the address and finds the next node or
+ * the leaf with a popcount over the bitmaps of the current node.
+ *
+ * @param trie the poptrie containing all the prefixes
+ * @param addr the address to match in network order
+ * @param info caller storage that receives the next hop and interface
+ * @return hop_status_t VALID if a route was found or INVALID otherwise.
+ */
+hop_status_t poptrie_lookup(const poptrie_t *__restrict__ trie, uint32_t addr, hop_info_t *__restrict__ info) {
+    if ((trie == NULL) || (info == NULL)) {
+        return INVALID;
+    }
+
+    uint32_t key = ntohl(addr);
+    uint32_t leaf = trie->direct[key >> (32 - POPTRIE_DIRECT_BITS)];
+
+    if ((leaf & POPTRIE_LEAF) != 0) {
+        leaf &= ~POPTRIE_LEAF;
+    } else {
+        const poptrie_node_t *node = trie->nodes + leaf;
+        uint32_t offset = POPTRIE_DIRECT_BITS;
+        uint32_t idx = poptrie_chunk(key, offset);
+
+        while ((node->vector & (1ULL << idx)) != 0) {
+            uint64_t below = node->vector & ((2ULL << idx) - 1);
+            node = trie->nodes + node->base1 + __builtin_popcountll(below) - 1;
+
+            offset += POPTRIE_STRIDE;
+            idx = poptrie_chunk(key, offset);
+        }
+
+        uint64_t below = node->leafvec & ((2ULL << idx) - 1);
+        leaf = trie->leaves[node->base0 + __builtin_popcountll(below) - 1];
+    }
+
+    if (leaf == 0) {
+        info->status = INVALID;
+        return INVALID;
+    }
+
+    *info = trie->hops[leaf - 1];
+
+    return VALID;
+}
+
+/*
+ * Describes the children of a chunk of the binary trie, a slot either
+ * continues into a binary trie node that has more specific prefixes or
+ * ends into a leaf holding the best hop seen on the path to it.
+ */
+typedef struct poptrie_slots_s {
+    uint32_t *bnodes;
+    uint32_t *leaves;
+} poptrie_slots_t;
+
+static void poptrie_fill_slots(poptrie_slots_t *__restrict__ slots, uint32_t first, uint32_t count, uint32_t leaf) {
+    for (uint32_t i = first; i < first + count; ++i) {
+        slots->bnodes[i] = BTRIE_NIL;
+        slots->leaves[i] = leaf;
+    }
+}
+
+static void poptrie_expand(const btrie_t *__restrict__ tree, uint32_t bnode_idx, uint32_t depth, uint32_t end_depth,
+                           uint32_t slot, uint32_t best, poptrie_slots_t *__restrict__ slots) {
+    const btrie_node_t *bnode = tree->nodes + bnode_idx;
+
+    if (bnode->info != BTRIE_EMPTY) {
+        best = bnode->info;
+    }
+
+    if (depth == end_depth) {
+        int has_children = (bnode->left != BTRIE_NIL) || (bnode->right != BTRIE_NIL);
+
+        slots->bnodes[slot] = has_children ? bnode_idx : BTRIE_NIL;
+        slots->leaves[slot] = best;
+
+        return;
+    }
+
+    uint32_t width = end_depth - depth - 1;
+
+    for (uint32_t bit = 0; bit < 2; ++bit) {
+        uint32_t child = (bit == 0) ? bnode->left : bnode->right;
+        uint32_t child_slot = (slot << 1) | bit;
+
+        if (child == BTRIE_NIL) {
+            poptrie_fill_slots(slots, child_slot << width, 1u << width, best);
+        } else {
+            poptrie_expand(tree, child, depth + 1, end_depth, child_slot, best, slots);
+        }
+    }
+}
+
+static int poptrie_grow(void **array, uint32_t *cap, uint32_t needed, size_t elem_size) {
+    if (needed <= *cap) {
+        return 0;
+    }
+
+    uint32_t new_cap = (*cap == 0) ? 1024 : *cap;
+    while (new_cap < needed) {
+        new_cap <<= 1;
+    }
+
+    void *new_array = realloc(*array, elem_size * new_cap);
+
+    if (new_array == NULL) {
+        return -1;
+    }
+
+    *array = new_array;
+    *cap = new_cap;
+
+    return 0;
+}
+
+static int poptrie_alloc_nodes(poptrie_t *__restrict__ trie, uint32_t count, uint32_t *first) {
+    if (poptrie_grow((void **)&trie->nodes, &trie->nodes_cap, trie->nodes_len + count, sizeof *trie->nodes) != 0) {
+        return -1;
+    }
+
+    *first = trie->nodes_len;
+    trie->nodes_len += count;
+
+    return 0;
+}
+
+static int poptrie_build_node(poptrie_t *__restrict__ trie, const btrie_t *__restrict__ tree,
+                              uint32_t node_idx, uint32_t bnode_idx, uint32_t depth, uint32_t best) {
+    uint32_t bnodes[POPTRIE_FANOUT];
+    uint32_t leaves[POPTRIE_FANOUT];
+    poptrie_slots_t slots = { .bnodes = bnodes, .leaves = leaves };
+
+    poptrie_expand(tree, bnode_idx, depth, depth + POPTRIE_STRIDE, 0, best, &slots);
+
+    uint64_t vector = 0;
+    uint64_t leafvec = 0;
+    uint32_t children = 0;
+    uint32_t runs = 0;
+    uint32_t last_leaf = 0;
+
+    for (uint32_t i = 0; i < POPTRIE_FANOUT; ++i) {
+        if (bnodes[i] != BTRIE_NIL) {
+            vector |= (1ULL << i);
+            ++children;
+        } else if ((runs == 0) || (leaves[i] != last_leaf)) {
+
+            /* Equal neighbour leaves are compressed in a single run */
+            leafvec |= (1ULL << i);
+            last_leaf = leaves[i];
+            ++runs;
+        }
+    }
+
+    uint32_t base0 = trie->leaves_len;
+    uint32_t base1 = 0;
+
+    if (poptrie_grow((void **)&trie->leaves, &trie->leaves_cap, trie->leaves_len + runs, sizeof *trie->leaves) != 0) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < POPTRIE_FANOUT; ++i) {
+        if ((leafvec & (1ULL << i)) != 0) {
+            trie->leaves[trie->leaves_len++] = leaves[i];
+        }
+    }
+
+    if ((children != 0) && (poptrie_alloc_nodes(trie, children, &base1) != 0)) {
+        return -1;
+    }
+
+    trie->nodes[node_idx].vector = vector;
+    trie->nodes[node_idx].leafvec = leafvec;
+    trie->nodes[node_idx].base0 = base0;
+    trie->nodes[node_idx].base1 = base1;
+
+    /* The children are allocated together, so the popcount can index them */
+    for (uint32_t i = 0, child = base1; i < POPTRIE_FANOUT; ++i) {
+        if (bnodes[i] != BTRIE_NIL) {
+            if (poptrie_build_node(trie, tree, child++, bnodes[i], depth + POPTRIE_STRIDE, leaves[i]) != 0) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int poptrie_build_direct(poptrie_t *__restrict__ trie, const btrie_t *__restrict__ tree) {
+    uint32_t direct_size = (1u << POPTRIE_DIRECT_BITS);
+    poptrie_slots_t slots = {
+        .bnodes = malloc(sizeof *slots.bnodes * direct_size),
+        .leaves = malloc(sizeof *slots.leaves * direct_size)
+    };
+    int ret = -1;
+
+    if ((slots.bnodes != NULL) && (slots.leaves != NULL)) {
+        poptrie_expand(tree, BTRIE_ROOT, 0, POPTRIE_DIRECT_BITS, 0, BTRIE_EMPTY, &slots);
+        ret = 0;
+
+        for (uint32_t i = 0; (i < direct_size) && (ret == 0); ++i) {
+            uint32_t node_idx = 0;
+
+            if (slots.bnodes[i] == BTRIE_NIL) {
+                trie->direct[i] = POPTRIE_LEAF | slots.leaves[i];
+            } else if (poptrie_alloc_nodes(trie, 1, &node_idx) != 0) {
+                ret = -1;
+            } else {
+                trie->direct[i] = node_idx;
+                ret = poptrie_build_node(trie, tree, node_idx, slots.bnodes[i], POPTRIE_DIRECT_BITS, slots.leaves[i]);
+            }
+        }
+    }
+
+    free(slots.bnodes);
+    free(slots.leaves);
+
+    return ret;
+}
+
+/**
+ * @brief Builds a poptrie from the routes of a binary trie, the
+ * leaves keep the hop indices of the binary trie so both structures
+ * give the same longest prefix matches.
+ *
+ * @param tree the binary trie holding the routing table
+ * @return poptrie_t* an allocated poptrie or NULL on failure
+ */
+poptrie_t* poptrie_build(const btrie_t *__restrict__ tree) {
+    if (tree == NULL) {
+        return NULL;
+    }
+
+    poptrie_t *new_trie = calloc(1, sizeof *new_trie);
+
+    if (new_trie != NULL) {
+        new_trie->direct = malloc(sizeof *new_trie->direct * (1u << POPTRIE_DIRECT_BITS));
+        new_trie->hops = malloc(sizeof *new_trie->hops * (tree->hops_len + 1));
+
+        if ((new_trie->direct == NULL) || (new_trie->hops == NULL) ||
+            (poptrie_build_direct(new_trie, tree) != 0)) {
+            free_poptrie(&new_trie);
+        } else {
+            memcpy(new_trie->hops, tree->hops, sizeof *new_trie->hops * tree->hops_len);
+            new_trie->hops_len = tree->hops_len;
+            new_trie->size = tree->size;
+        }
+    }
+
+    return new_trie;
+}
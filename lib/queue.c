@@ -1,50 +1,89 @@
 #include "queue.h"
-#include "list.h"
+#include "ring.h"
 #include <stdlib.h>
 #include <assert.h>
 
+#define QUEUE_INIT_SIZE 64
+
+/*
+ * The queue keeps its elements in a single producer ring that is
+ * replaced by one twice as large when it is full, up to RING_MAX_SIZE
+ * elements. It is used by one thread, the threads that hand elements
+ * to each other share a ring_t directly.
+ */
 struct queue
 {
-	list head;
-	list tail;
+	ring_t *ring;
 };
 
 queue queue_create(void)
 {
 	queue q = malloc(sizeof(struct queue));
-	q->head = q->tail = NULL;
+
+	if (q == NULL)
+		return NULL;
+
+	q->ring = create_ring(QUEUE_INIT_SIZE, RING_SINGLE_PRODUCER);
+
+	if (q->ring == NULL) {
+		free(q);
+		return NULL;
+	}
+
 	return q;
 }
 
 int queue_empty(queue q)
 {
-	return q->head == NULL;
+	return ring_count(q->ring) == 0;
 }
 
-void queue_enq(queue q, void *element)
+static int queue_grow(queue q)
 {
-	if(queue_empty(q)) {
-		q->head = q->tail = cons(element, NULL);
-	} else {
-		q->tail->next = cons(element, NULL);
-		q->tail = q->tail->next;
+	void *elements[QUEUE_INIT_SIZE];
+	uint32_t len;
+
+	if (q->ring->size >= RING_MAX_SIZE)
+		return -1;
+
+	ring_t *ring = create_ring(q->ring->size << 1, RING_SINGLE_PRODUCER);
+
+	if (ring == NULL)
+		return -1;
+
+	/* Move the elements in order, a burst at a time */
+	while ((len = ring_dequeue_burst(q->ring, elements, QUEUE_INIT_SIZE)) != 0)
+		ring_enqueue_burst(ring, elements, len);
+
+	free_ring(&q->ring);
+	q->ring = ring;
+
+	return 0;
+}
+
+int queue_enq(queue q, void *element)
+{
+	if (ring_enqueue_burst(q->ring, &element, 1) == 0) {
+		if (queue_grow(q) != 0)
+			return -1;
+
+		ring_enqueue_burst(q->ring, &element, 1);
 	}
+
+	return 0;
 }
 
 void *queue_deq(queue q)
 {
 	assert(!queue_empty(q));
 	{
-		void *temp = q->head->element;
-		q->head = cdr_and_free(q->head);
+		void *temp;
+		ring_dequeue_burst(q->ring, &temp, 1);
 		return temp;
 	}
 }
 
 void queue_free(queue q) {
-	while (!queue_empty(q)) {
-		(void)queue_deq(q);
-	}
-
+	free_ring(&q->ring);
 	free(q);
 }
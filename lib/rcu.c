@@ -0,0 +1,109 @@
+#include "rcu.h"
+
+#include <unistd.h>
+
+/**
+ * @brief Create a rcu object.
+ *
+ * @return rcu_t* returns a RCU domain without readers.
+ */
+rcu_t* create_rcu(void) {
+    rcu_t *new_rcu = malloc(sizeof *new_rcu);
+
+    if (new_rcu != NULL) {
+        if (pthread_mutex_init(&new_rcu->lock, NULL) != 0) {
+            free(new_rcu);
+            return NULL;
+        }
+
+        atomic_init(&new_rcu->period, 1);
+        new_rcu->readers = NULL;
+    }
+
+    return new_rcu;
+}
+
+/**
+ * @brief Frees the memory allocated for the RCU domain, the readers
+ * are owned by their threads and have to be unregistered before.
+ *
+ * @param rcu a pointer to the RCU domain.
+ */
+void free_rcu(rcu_t **__restrict__ rcu) {
+    if ((rcu != NULL) && (*rcu != NULL)) {
+        pthread_mutex_destroy(&(*rcu)->lock);
+
+        free(*rcu);
+        *rcu = NULL;
+    }
+}
+
+/**
+ * @brief Adds a reader to the domain, the reader starts online.
+ *
+ * @param rcu the RCU domain
+ * @param reader the reader of the calling thread
+ */
+void rcu_register(rcu_t *__restrict__ rcu, rcu_reader_t *__restrict__ reader) {
+    if ((rcu != NULL) && (reader != NULL)) {
+        rcu_online(rcu, reader);
+
+        pthread_mutex_lock(&rcu->lock);
+        reader->next = rcu->readers;
+        rcu->readers = reader;
+        pthread_mutex_unlock(&rcu->lock);
+    }
+}
+
+/**
+ * @brief Removes a reader from the domain.
+ *
+ * @param rcu the RCU domain
+ * @param reader the reader of the calling thread
+ */
+void rcu_unregister(rcu_t *__restrict__ rcu, rcu_reader_t *__restrict__ reader) {
+    if ((rcu != NULL) && (reader != NULL)) {
+        pthread_mutex_lock(&rcu->lock);
+
+        for (rcu_reader_t **iter = &rcu->readers; *iter != NULL; iter = &(*iter)->next) {
+            if (*iter == reader) {
+                *iter = reader->next;
+                break;
+            }
+        }
+
+        pthread_mutex_unlock(&rcu->lock);
+    }
+}
+
+/**
+ * @brief Waits for a grace period, when it returns every reader went
+ * through a quiescent state or offline after the call, so the data
+ * unpublished before the call can be freed. The caller must not be
+ * an online reader of the domain.
+ *
+ * @param rcu the RCU domain
+ */
+void rcu_synchronize(rcu_t *__restrict__ rcu) {
+    if (rcu == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&rcu->lock);
+
+    uint64_t period = atomic_fetch_add(&rcu->period, 1) + 1;
+
+    for (rcu_reader_t *iter = rcu->readers; iter != NULL; iter = iter->next) {
+        for (;;) {
+            uint64_t seen = atomic_load(&iter->period);
+
+            if ((seen == RCU_OFFLINE) || (seen >= period)) {
+                break;
+            }
+
+            usleep(RCU_WAIT_US);
+        }
+    }
+
+    pthread_mutex_unlock(&rcu->lock);
+}
@@ -0,0 +1,50 @@
+#include "ring.h"
+
+/**
+ * @brief Create a ring object.
+ *
+ * @param count the most elements stored at once, rounded up to a power of two
+ * @param flags RING_SINGLE_PRODUCER or RING_MULTI_PRODUCER
+ * @return ring_t* returns an empty ring or NULL on failure.
+ */
+ring_t* create_ring(uint32_t count, int flags) {
+    if ((count == 0) || (count > RING_MAX_SIZE) ||
+        ((flags != RING_SINGLE_PRODUCER) && (flags != RING_MULTI_PRODUCER))) {
+        return NULL;
+    }
+
+    uint32_t slots = 1;
+
+    while (slots < count) {
+        slots <<= 1;
+    }
+
+    /* The slots start on their own cache line, the size is rounded up to the alignment */
+    size_t size = sizeof(ring_t) + sizeof(void *) * slots;
+    ring_t *new_ring = aligned_alloc(RING_CACHE_LINE, (size + RING_CACHE_LINE - 1) & ~((size_t)RING_CACHE_LINE - 1));
+
+    if (new_ring != NULL) {
+        new_ring->mask = slots - 1;
+        new_ring->size = slots;
+        new_ring->flags = flags;
+
+        atomic_init(&new_ring->prod.head, 0);
+        atomic_init(&new_ring->prod.tail, 0);
+        atomic_init(&new_ring->cons.tail, 0);
+    }
+
+    return new_ring;
+}
+
+/**
+ * @brief Frees the memory allocated for the ring, the elements
+ * still stored are not freed.
+ *
+ * @param ring a pointer to the ring.
+ */
+void free_ring(ring_t **__restrict__ ring) {
+    if ((ring != NULL) && (*ring != NULL)) {
+        free(*ring);
+        *ring = NULL;
+    }
+}
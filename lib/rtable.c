@@ -0,0 +1,367 @@
+#include "rtable.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * A part of the file parsed by one thread. The part starts at the
+ * beginning of a line and ends after a new line or at the end of
+ * the file, the malformed lines are kept as indices in the part.
+ */
+typedef struct rtable_chunk_s {
+    const char *start;
+    const char *end;
+
+    struct route_table_entry *routes;
+    size_t routes_len;
+    size_t routes_cap;
+
+    size_t *errors;
+    size_t errors_len;
+    size_t errors_cap;
+
+    size_t lines;
+    int failed;                 /* Out of memory */
+} rtable_chunk_t;
+
+static inline const char* rtable_skip_blanks(const char *iter, const char *end) {
+    while ((iter < end) && ((*iter == ' ') || (*iter == '\t'))) {
+        ++iter;
+    }
+
+    return iter;
+}
+
+static const char* rtable_parse_number(const char *iter, const char *end, uint32_t max, uint32_t *value) {
+    const char *start = iter;
+    uint32_t number = 0;
+
+    while ((iter < end) && ((unsigned char)(*iter - '0') <= 9)) {
+        uint32_t digit = (uint32_t)(*iter - '0');
+
+        /* Check the bound before the value could overflow */
+        if (number > (max - digit) / 10) {
+            return NULL;
+        }
+
+        number = number * 10 + digit;
+        ++iter;
+    }
+
+    if (iter == start) {
+        return NULL;
+    }
+
+    *value = number;
+
+    return iter;
+}
+
+static const char* rtable_parse_addr(const char *iter, const char *end, uint32_t *addr) {
+    uint32_t host = 0;
+
+    for (int i = 0; i < 4; ++i) {
+        uint32_t octet;
+
+        if ((i != 0) && ((iter >= end) || (*(iter++) != '.'))) {
+            return NULL;
+        }
+
+        if ((iter = rtable_parse_number(iter, end, 255, &octet)) == NULL) {
+            return NULL;
+        }
+
+        host = (host << 8) | octet;
+    }
+
+    *addr = htonl(host);
+
+    return iter;
+}
+
+/**
+ * @brief Decodes one line of the routing table.
+ *
+ * @param iter the start of the line
+ * @param end the end of the line, without the new line
+ * @param route receives the decoded route
+ * @return int 1 if a route was decoded, 0 for a blank line or
+ * -1 for a malformed line.
+ */
+int rtable_parse_route(const char *iter, const char *end, struct route_table_entry *route) {
+    uint32_t prefix, next_hop, mask, interface;
+
+    /* Tolerate the tables written with CRLF line endings */
+    if ((end > iter) && (end[-1] == '\r')) {
+        --end;
+    }
+
+    iter = rtable_skip_blanks(iter, end);
+
+    if (iter == end) {
+        return 0;
+    }
+
+    if (((iter = rtable_parse_addr(iter, end, &prefix)) == NULL) ||
+        ((iter = rtable_parse_addr(rtable_skip_blanks(iter, end), end, &next_hop)) == NULL) ||
+        ((iter = rtable_parse_addr(rtable_skip_blanks(iter, end), end, &mask)) == NULL) ||
+        ((iter = rtable_parse_number(rtable_skip_blanks(iter, end), end, INT32_MAX, &interface)) == NULL)) {
+        return -1;
+    }
+
+    if (rtable_skip_blanks(iter, end) != end) {
+        return -1;
+    }
+
+    /* The engines take the number of mask bits as the prefix length, so the ones have to lead */
+    uint32_t host_bits = ~ntohl(mask);
+
+    if ((host_bits & (host_bits + 1)) != 0) {
+        return -1;
+    }
+
+    /* The bits of the prefix outside the mask are not part of the route */
+    prefix &= mask;
+
+    route->prefix = prefix;
+    route->next_hop = next_hop;
+    route->mask = mask;
+    route->interface = (int)interface;
+
+    return 1;
+}
+
+static int rtable_chunk_push(void **array, size_t *len, size_t *cap, size_t elem_size) {
+    if (*len == *cap) {
+        size_t new_cap = (*cap == 0) ? 1024 : (*cap << 1);
+        void *new_array = realloc(*array, elem_size * new_cap);
+
+        if (new_array == NULL) {
+            return -1;
+        }
+
+        *array = new_array;
+        *cap = new_cap;
+    }
+
+    return 0;
+}
+
+static void* rtable_parse_chunk(void *arg) {
+    rtable_chunk_t *chunk = arg;
+    const char *iter = chunk->start;
+
+    while ((iter < chunk->end) && (chunk->failed == 0)) {
+        const char *line_end = memchr(iter, '\n', (size_t)(chunk->end - iter));
+
+        if (line_end == NULL) {
+            line_end = chunk->end;
+        }
+
+        if (rtable_chunk_push((void **)&chunk->routes, &chunk->routes_len, &chunk->routes_cap,
+                              sizeof *chunk->routes) != 0) {
+            chunk->failed = 1;
+            break;
+        }
+
+        int status = rtable_parse_route(iter, line_end, chunk->routes + chunk->routes_len);
+
+        if (status > 0) {
+            ++(chunk->routes_len);
+        } else if (status < 0) {
+            if (rtable_chunk_push((void **)&chunk->errors, &chunk->errors_len, &chunk->errors_cap,
+                                  sizeof *chunk->errors) != 0) {
+                chunk->failed = 1;
+                break;
+            }
+
+            chunk->errors[chunk->errors_len++] = chunk->lines;
+        }
+
+        ++(chunk->lines);
+        iter = line_end + 1;
+    }
+
+    return NULL;
+}
+
+static unsigned int rtable_threads(size_t size, unsigned int threads) {
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cpus > 0) ? (unsigned int)cpus : 1;
+    }
+
+    if (threads > RTABLE_MAX_THREADS) {
+        threads = RTABLE_MAX_THREADS;
+    }
+
+    /* A thread is not worth starting for a small part of the file */
+    if (threads > size / RTABLE_CHUNK_SIZE) {
+        threads = (unsigned int)(size / RTABLE_CHUNK_SIZE);
+    }
+
+    return (threads == 0) ? 1 : threads;
+}
+
+static int rtable_merge(rtable_t *__restrict__ table, rtable_chunk_t *__restrict__ chunks, unsigned int chunks_len,
+                        const char *filename) {
+    size_t len = 0;
+    size_t line = 1;
+
+    for (unsigned int i = 0; i < chunks_len; ++i) {
+        if (chunks[i].failed != 0) {
+            return -1;
+        }
+
+        len += chunks[i].routes_len;
+    }
+
+    table->routes = malloc(sizeof *table->routes * (len == 0 ? 1 : len));
+
+    if (table->routes == NULL) {
+        return -1;
+    }
+
+    /* The chunks follow the order of the file, so the later routes still win */
+    for (unsigned int i = 0; i < chunks_len; ++i) {
+        memcpy(table->routes + table->len, chunks[i].routes, sizeof *chunks[i].routes * chunks[i].routes_len);
+        table->len += chunks[i].routes_len;
+
+        for (size_t j = 0; j < chunks[i].errors_len; ++j) {
+            fprintf(stderr, "%s:%zu: malformed route, the line is skipped\n", filename, line + chunks[i].errors[j]);
+        }
+
+        table->errors += chunks[i].errors_len;
+        line += chunks[i].lines;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Parses a text routing table. The file is mapped and split in
+ * parts that end on a new line, every part is decoded by its own
+ * thread and the routes are gathered in the order of the file. The
+ * malformed lines are reported with their number and skipped.
+ *
+ * @param filename the file to read the routes
+ * @param threads the most threads to use, 0 for one per CPU
+ * @return rtable_t* the parsed routes or NULL on failure
+ */
+rtable_t* rtable_parse(const char *filename, unsigned int threads) {
+    if (filename == NULL) {
+        return NULL;
+    }
+
+    int fd = open(filename, O_RDONLY);
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t)st.st_size;
+    const char *text = NULL;
+
+    if (size != 0) {
+        text = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    }
+
+    close(fd);
+
+    if (text == MAP_FAILED) {
+        return NULL;
+    }
+
+    rtable_t *new_table = calloc(1, sizeof *new_table);
+    unsigned int chunks_len = rtable_threads(size, threads);
+    rtable_chunk_t *chunks = calloc(chunks_len, sizeof *chunks);
+    pthread_t *workers = calloc(chunks_len, sizeof *workers);
+    int error = ((new_table == NULL) || (chunks == NULL) || (workers == NULL));
+
+    if (error == 0) {
+        const char *start = text;
+
+        for (unsigned int i = 0; i < chunks_len; ++i) {
+            const char *end = text + size;
+
+            /* Move the bound to the end of the line it falls into */
+            if (i + 1 < chunks_len) {
+                end = text + (size / chunks_len) * (i + 1);
+                end = (end < start) ? start : end;
+
+                const char *line_end = memchr(end, '\n', (size_t)(text + size - end));
+                end = (line_end == NULL) ? (text + size) : (line_end + 1);
+            }
+
+            chunks[i].start = start;
+            chunks[i].end = end;
+            start = end;
+        }
+
+        /* The first part is parsed by the calling thread */
+        unsigned int started = 1;
+
+        for (; started < chunks_len; ++started) {
+            if (pthread_create(workers + started, NULL, rtable_parse_chunk, chunks + started) != 0) {
+                break;
+            }
+        }
+
+        rtable_parse_chunk(chunks);
+
+        for (unsigned int i = 1; i < started; ++i) {
+            pthread_join(workers[i], NULL);
+        }
+
+        /* The parts of the threads that could not start are parsed here */
+        for (unsigned int i = started; i < chunks_len; ++i) {
+            rtable_parse_chunk(chunks + i);
+        }
+
+        error = rtable_merge(new_table, chunks, chunks_len, filename);
+    }
+
+    if (chunks != NULL) {
+        for (unsigned int i = 0; i < chunks_len; ++i) {
+            free(chunks[i].routes);
+            free(chunks[i].errors);
+        }
+    }
+
+    free(chunks);
+    free(workers);
+
+    if (text != NULL) {
+        munmap((void *)text, size);
+    }
+
+    if (error != 0) {
+        free_rtable(&new_table);
+    }
+
+    return new_table;
+}
+
+/**
+ * @brief Frees the memory allocated for the parsed routes.
+ *
+ * @param table a pointer to the parsed routing table.
+ */
+void free_rtable(rtable_t **__restrict__ table) {
+    if ((table != NULL) && (*table != NULL)) {
+        free((*table)->routes);
+
+        free(*table);
+        *table = NULL;
+    }
+}
@@ -1,207 +1,314 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
 #include "utils.h"
 
-static void generate_arp_request(router_t *this) {
-	this->arp_hdr = (struct arp_header *)(this->buf + sizeof *this->eth_hdr);
+static uint64_t now_ms(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+static void send_arp_request(int interface, uint32_t target) {
+	char frame[sizeof(struct ether_header) + sizeof(struct arp_header)];
+	struct ether_header *eth_hdr = (struct ether_header *)frame;
+	struct arp_header *arp_hdr = (struct arp_header *)(frame + sizeof *eth_hdr);
 
-	this->eth_hdr->ether_type = ARP_TYPE;
+	eth_hdr->ether_type = ARP_TYPE;
 
 	/* Initiate a broadcast packet */
-	get_interface_mac(this->interface, this->eth_hdr->ether_shost);
-	memset(this->eth_hdr->ether_dhost, 0xff, MAC_ADDR_SIZE);
+	get_interface_mac(interface, eth_hdr->ether_shost);
+	memset(eth_hdr->ether_dhost, 0xff, MAC_ADDR_SIZE);
 
 	/* Initiate the basic ARP Request flags */
-	this->arp_hdr->htype = HTYPE_ETHER;
-	this->arp_hdr->ptype = IP_TYPE;
-	this->arp_hdr->hlen = HW_LEN;
-	this->arp_hdr->plen = PT_LEN;
-	this->arp_hdr->op = OP_REQUEST;
+	arp_hdr->htype = HTYPE_ETHER;
+	arp_hdr->ptype = IP_TYPE;
+	arp_hdr->hlen = HW_LEN;
+	arp_hdr->plen = PT_LEN;
+	arp_hdr->op = OP_REQUEST;
 
 	/* Set the source and the target ip addresses and mac addresses (0 for target) */
 
-	get_interface_mac(this->interface, this->arp_hdr->sha);
-	this->arp_hdr->spa = get_interface_ipv4(this->interface);
+	get_interface_mac(interface, arp_hdr->sha);
+	arp_hdr->spa = get_interface_ipv4(interface);
 
-	memset(this->arp_hdr->tha, 0, MAC_ADDR_SIZE);
-	this->arp_hdr->tpa = this->next_hop;
+	memset(arp_hdr->tha, 0, MAC_ADDR_SIZE);
+	arp_hdr->tpa = target;
 
-	/* Update the packet length for sending */
-	this->len = sizeof(*this->eth_hdr) + sizeof(*this->arp_hdr);
+	/* The request is built aside, so the packet that needed it stays untouched */
+	send_to_link(interface, frame, sizeof frame);
 }
 
-static void generate_ipv4_header(router_t *this, uint8_t type) {
+static void own_frame(worker_t *this) {
+
+	/* A frame read in place from a ring is copied in the packet buffer before it grows or waits */
+	if (this->buf != this->pckg->buf) {
+		memcpy(this->pckg->buf, this->buf, this->len);
+
+		this->buf = this->pckg->buf;
+		this->eth_hdr = (struct ether_header *)this->buf;
+		this->ip_hdr = (struct iphdr *)(this->buf + sizeof *this->eth_hdr);
+	}
+}
+
+static void generate_ipv4_header(worker_t *this, size_t payload) {
 
 	/* Set the fields */
 	this->ip_hdr->ihl = 5;
 	this->ip_hdr->version = 4;
 	this->ip_hdr->tos = 0;
 
-	/* Compute the total length as one ipv4 header and one icmp */
-	this->ip_hdr->tot_len = sizeof *this->ip_hdr + sizeof *this->icmp_hdr;
-	if ((type == ICMP_TIME_EXCED) || (type == ICMP_DEST_UNREACH)) {
-
-		/*
-		 * If the replay is a time limit or host unreachable then
-		 * we also send the original ipv4 header and 64 bits, so
-		 * we add it to the total size
-		*/
-		this->ip_hdr->tot_len += sizeof *this->ip_hdr + 8;
-	}
-	this->ip_hdr->tot_len = htons(this->ip_hdr->tot_len);
+	/* Compute the total length as one ipv4 header and the icmp message */
+	this->ip_hdr->tot_len = htons(sizeof *this->ip_hdr + payload);
 
 	this->ip_hdr->id = htons(1);
 	this->ip_hdr->frag_off = 0;
 	this->ip_hdr->ttl = 64;
 	this->ip_hdr->protocol = 1;
-	this->ip_hdr->check = 0;
-	this->ip_hdr->check = htons(checksum((uint16_t *)this->ip_hdr, sizeof *this->ip_hdr));
 
 	/* Set the addresses in order to send the packet to the source */
 	this->ip_hdr->daddr = this->ip_hdr->saddr;
 	this->ip_hdr->saddr = get_interface_ipv4(this->interface);
+
+	/* The checksum covers the new addresses too */
+	this->ip_hdr->check = 0;
+	this->ip_hdr->check = csum_fold(csum_partial(this->ip_hdr, sizeof *this->ip_hdr, 0));
 }
 
-static void generate_icmp_replay(router_t *this, uint8_t type) {
-	this->icmp_hdr = (struct icmphdr *)(this->buf + sizeof *this->eth_hdr + sizeof *this->ip_hdr);
+static void generate_icmp_replay(worker_t *this, uint8_t type) {
+	own_frame(this);
 
-	this->len = sizeof *this->eth_hdr + sizeof *this->ip_hdr + sizeof *this->icmp_hdr;
+	size_t ip_len = this->ip_hdr->ihl * 4;
+	size_t data_len = this->len - sizeof *this->eth_hdr;
+	size_t icmp_len;
+	char *icmp = this->buf + sizeof *this->eth_hdr + ip_len;
+
+	this->icmp_hdr = (struct icmphdr *)(this->buf + sizeof *this->eth_hdr + sizeof *this->ip_hdr);
 
-	/* Copy the ipv4 header that generated an error in forwarding */
 	if ((type == ICMP_TIME_EXCED) || (type == ICMP_DEST_UNREACH)) {
-		memcpy(this->buf + this->len, this->ip_hdr, sizeof *this->ip_hdr);
-		this->len += sizeof *this->ip_hdr;	
 
-		memcpy(this->buf + this->len, this->ip_hdr + sizeof *this->ip_hdr, 8);
-		this->len += 8;
+		/* The ipv4 header that generated an error in forwarding and 64 bits of its data follow the icmp header */
+		icmp_len = (ip_len + 8 < data_len) ? ip_len + 8 : data_len;
+		memmove((char *)(this->icmp_hdr + 1), this->ip_hdr, icmp_len);
+
+		memset(this->icmp_hdr, 0, sizeof *this->icmp_hdr);
+		icmp_len += sizeof *this->icmp_hdr;
+	} else {
+
+		/* The echo replay keeps the identifier, the sequence number and the data of the request */
+		icmp_len = (ntohs(this->ip_hdr->tot_len) < data_len) ? ntohs(this->ip_hdr->tot_len) : data_len;
+		icmp_len = (icmp_len > ip_len + sizeof *this->icmp_hdr) ? icmp_len - ip_len : sizeof *this->icmp_hdr;
+
+		/* The options of the request are not sent back */
+		memmove(this->icmp_hdr, icmp, icmp_len);
 	}
 
+	this->len = sizeof *this->eth_hdr + sizeof *this->ip_hdr + icmp_len;
+
 	/* Set the type and the code for the icmp replay */
 	this->icmp_hdr->type = type;
 	this->icmp_hdr->code = 0;
 
-	/* Compute the checksum of the icmp header */
+	/* Compute the checksum of the whole icmp message */
 	this->icmp_hdr->checksum = 0;
-	this->icmp_hdr->checksum = htons(checksum((uint16_t *)this->icmp_hdr, sizeof *this->icmp_hdr));
+	this->icmp_hdr->checksum = csum_fold(csum_partial(this->icmp_hdr, icmp_len, 0));
 
 	/* Generate a new ipv4 header for the new packet */
-	generate_ipv4_header(this, type);
+	generate_ipv4_header(this, icmp_len);
 
 	/* Update the ethernet header, to send the replay to the source */
 	memcpy(this->eth_hdr->ether_dhost, this->eth_hdr->ether_shost, MAC_ADDR_SIZE);
 	get_interface_mac(this->interface, this->eth_hdr->ether_shost);
 }
 
-static packed_msg_t* pack_the_msg(router_t *this) {
-	if (this == NULL) {
-		return NULL;
-	}
+static void own_packet(worker_t *this, packed_msg_t *pckg) {
+	this->pckg = pckg;
+	this->buf = pckg->buf;
+	this->burst[this->burst_index] = pckg;
+}
 
-	packed_msg_t *new_pckg = malloc(sizeof *new_pckg);
+static void drop_packed_msg(arp_pending_t *pending, void *arg) {
+	packet_pool_release((packet_pool_t *)arg, pending);
+}
 
-	if (new_pckg != NULL) {
-		new_pckg->buf = malloc(MAX_PACKET_LEN);
+static void release_packed_msg(router_t *router, packed_msg_t *pckg) {
+	pthread_mutex_lock(&router->neigh_lock);
+	packet_pool_release(router->packets, pckg);
+	pthread_mutex_unlock(&router->neigh_lock);
+}
 
-		if (new_pckg->buf != NULL) {
-			memcpy(new_pckg->buf, this->buf, this->len);
+static void punt_packet(worker_t *this, punt_reason_t reason) {
+	router_t *router = this->router;
 
-			new_pckg->len = this->len;
-			new_pckg->interface = this->interface;
-			new_pckg->hop = this->next_hop;
-		} else {
-			free(new_pckg);
-			new_pckg = NULL;
+	/* A full ring drops the packet before the pool is locked, so a storm of exceptions can not hold back the workers */
+	if (ring_count(router->punt) >= router->punt->size) {
+		return;
+	}
+
+	/* The worker receives the next packets in a fresh buffer, without one the packet is dropped */
+	packed_msg_t *next = this->spare;
+
+	if (next == NULL) {
+		pthread_mutex_lock(&router->neigh_lock);
+		next = packet_pool_alloc(router->packets);
+		pthread_mutex_unlock(&router->neigh_lock);
+
+		if (next == NULL) {
+			return;
 		}
 	}
 
-	return new_pckg;
-}
+	this->spare = NULL;
+
+	own_frame(this);
+
+	this->pckg->len = this->len;
+	this->pckg->interface = this->interface;
+	this->pckg->hop = this->next_hop;
+	this->pckg->punt = reason;
+
+	void *punted = this->pckg;
 
-static void free_packed_msg(packed_msg_t *pckg) {
-	if (pckg != NULL) {
-		free(pckg->buf);
-		free(pckg);
+	if (ring_enqueue_burst(router->punt, &punted, 1) == 1) {
+		own_packet(this, next);
+		++(this->punted);
+	} else {
+
+		/* Other workers filled the ring meanwhile, the fresh buffer is kept for the next punt */
+		this->spare = next;
 	}
 }
 
-static void ipv4_handler(router_t *this) {
+static void ipv4_handler(worker_t *this) {
 	this->ip_hdr = (struct iphdr *)(this->buf + sizeof *this->eth_hdr);
 
-    uint16_t old_check = this->ip_hdr->check;
-	this->ip_hdr->check = 0;
+	/* A runt frame is dropped before its header is read */
+	if (this->len < sizeof *this->eth_hdr + sizeof *this->ip_hdr) {
+		return;
+	}
 
-	/* Check if the cheksum is good */
-	if (old_check == htons(checksum((uint16_t *)this->ip_hdr, sizeof *this->ip_hdr))) {
-		if (this->ip_hdr->daddr == get_interface_ipv4(this->interface)) {
+	size_t ip_len = this->ip_hdr->ihl * 4;
 
-			/* The packet was sent to this router so send a icmp replay */
-			generate_icmp_replay(this, ICMP_RESPONE);
-		} else {
+	/* A truncated header or a bad cheksum drops the packet, the sum over a valid header with its checksum folds to 0 */
+	if ((ip_len < sizeof *this->ip_hdr) || (ip_len > this->len - sizeof *this->eth_hdr) ||
+		(csum_fold(csum_partial(this->ip_hdr, ip_len, 0)) != 0)) {
+		return;
+	}
 
-			/* Compute the next hop via LPM */
-			hop_info_t* best_route = btrie_lpm(this->routes, this->ip_hdr->daddr);
+	if (this->ip_hdr->daddr == get_interface_ipv4(this->interface)) {
 
-			if (best_route == NULL) {
+		/* The packet was sent to this router, the slow path sends the icmp replay */
+		punt_packet(this, PUNT_ECHO);
+		return;
+	}
 
-				/*
-				 * If the best route is NULL it means there is no way to send
-				 * the packet so send back a icmp replay with host unreachable
-				 */
-				generate_icmp_replay(this, ICMP_DEST_UNREACH);
-			} else {
+	/* The next hop was matched via LPM together with the rest of the burst */
+	hop_info_t best_route = this->routes[this->burst_index];
 
-				/* The next hop was found so we try to sent the packet */
+	if (best_route.status == INVALID) {
 
-				this->next_hop = best_route->hop;
-				this->interface = best_route->interface;
+		/*
+		 * If the best route is NULL it means there is no way to send
+		 * the packet so the source gets a icmp replay with host unreachable
+		 */
+		punt_packet(this, PUNT_UNREACH);
+		return;
+	}
 
-				free(best_route);
+	/* Check if the packet lived enough or not, the time excedded replay goes back on the receiving interface */
+	if (this->ip_hdr->ttl <= 1) {
+		punt_packet(this, PUNT_TTL);
+		return;
+	}
 
-				/* Check if the packet lived enough or not */
-				if (this->ip_hdr->ttl > 1) {
+	/* The next hop was found so we try to sent the packet */
+	this->next_hop = best_route.hop;
+	this->interface = best_route.interface;
 
-					/* Compute the checksum after decrementing the time-to-live */
-					this->ip_hdr->check = 0;
-					this->ip_hdr->check = ~(~old_check + ~((uint16_t)this->ip_hdr->ttl) + (uint16_t)(this->ip_hdr->ttl - 1)) - 1;
-					this->ip_hdr->ttl -= 1;
+	/* Update the checksum for the word of the time-to-live (RFC 1624), the header is not summed again */
+	uint16_t old_word, new_word;
 
-					/* Try to fetch the MAC address of the next hop */
-					int entry_idx = get_mac_entry(this->macs, this->next_hop);
+	memcpy(&old_word, &this->ip_hdr->ttl, sizeof old_word);
+	this->ip_hdr->ttl -= 1;
+	memcpy(&new_word, &this->ip_hdr->ttl, sizeof new_word);
 
-					if (entry_idx < 0) {
+	this->ip_hdr->check = csum_update16(this->ip_hdr->check, old_word, new_word);
 
-						/* The MAC address was not found so send an ARP Request */
+	/*
+	 * Just a REACHABLE next hop is forwarded here, its adjacency writes the whole
+	 * ethernet header at once, the slow path resolves the others
+	 */
+	if (adj_table_lookup(this->router->adjs, this->next_hop, this->interface, now_ms(), this->buf) != 0) {
+		punt_packet(this, PUNT_RESOLVE);
+		return;
+	}
 
-						/* Pack the current message into the waiting queue */
-						packed_msg_t *pckg = pack_the_msg(this);
-						if (pckg != NULL) {
-							queue_enq(this->pckg_queue, (void *)pckg);
-						}
+	send_to_link_burst(this->interface, this->buf, this->len);
+}
 
-						/* Generate an arp request to the next hop to find MAC address */
-						generate_arp_request(this);
-					} else {
+static void arp_handler(worker_t *this) {
 
-						/* The MAC address was found, update the ethernet header */
-						memcpy(this->eth_hdr->ether_dhost, this->macs->addrs[entry_idx].mac, MAC_ADDR_SIZE);
-						get_interface_mac(this->interface, this->eth_hdr->ether_shost);
-					}
-				} else {
+	/* Every ARP packet is handled by the slow path */
+	punt_packet(this, PUNT_ARP);
+}
 
-					/* The packet lived enough, generate the time excedded icmp replay */
-					generate_icmp_replay(this, ICMP_TIME_EXCED);
-				}
-			}
-		}
+static void set_adjacency(router_t *router, const arp_cache_entry_t *entry, int interface) {
+	uint8_t iface_mac[MAC_ADDR_SIZE];
+
+	/* The workers forward to a REACHABLE neighbor until it must be confirmed again */
+	get_interface_mac(interface, iface_mac);
+	adj_table_set(router->adjs, entry->ip, interface, entry->mac, iface_mac, IP_TYPE,
+				  entry->confirmed + ARP_REACHABLE_MS);
+}
+
+static void slow_resolve(worker_t *this) {
+	router_t *router = this->router;
+	uint8_t next_mac[MAC_ADDR_SIZE];
+	const uint8_t *mac = NULL;
+
+	pthread_mutex_lock(&router->neigh_lock);
+
+	arp_action_t action = arp_cache_resolve(router->macs, this->next_hop, this->interface, now_ms(), &mac);
+
+	if (mac != NULL) {
+		memcpy(next_mac, mac, MAC_ADDR_SIZE);
+	}
+
+	const arp_cache_entry_t *entry = arp_cache_find(router->macs, this->next_hop);
+
+	if ((action == ARP_SEND) && (entry != NULL) && (entry->state == ARP_REACHABLE)) {
+		set_adjacency(router, entry, this->interface);
+	}
+
+	/* The packet waits in the queue of the next hop until the replay */
+	if (((action == ARP_QUEUE_REQUEST) || (action == ARP_QUEUE)) &&
+		(arp_cache_enqueue(router->macs, this->next_hop, &this->pckg->node) == 0)) {
+		this->pckg = NULL;
+	}
+
+	pthread_mutex_unlock(&router->neigh_lock);
+
+	/*
+	 * The first packet for an unresolved next hop sends the single request,
+	 * a stale MAC address is still used while a request confirms it
+	 */
+	if ((action == ARP_QUEUE_REQUEST) || (action == ARP_SEND_PROBE)) {
+		send_arp_request(this->interface, this->next_hop);
+	}
+
+	if ((action == ARP_SEND) || (action == ARP_SEND_PROBE)) {
+		memcpy(this->eth_hdr->ether_dhost, next_mac, MAC_ADDR_SIZE);
+		get_interface_mac(this->interface, this->eth_hdr->ether_shost);
 
-		/*
-		 * Send the modified packet to the next hop
-		 * or to another interface for an
-		 * ARP Request or ICMP Replay
-		 */
 		send_to_link(this->interface, this->buf, this->len);
 	}
 }
 
-static void generate_arp_replay(router_t *this) {
+static void generate_arp_replay(worker_t *this) {
 
 	/* Set the ARP Op Code as a replay */
 	this->arp_hdr->op = OP_REPLAY;
@@ -219,7 +326,7 @@ static void generate_arp_replay(router_t *this) {
 	get_interface_mac(this->interface, this->eth_hdr->ether_shost);
 }
 
-static void process_waiting_packet(router_t *this, packed_msg_t *pckg) {
+static void process_waiting_packet(worker_t *this, packed_msg_t *pckg, const uint8_t *mac) {
 
 	/* Populate the packet data into the router fields */
 	this->eth_hdr = (struct ether_header *)pckg->buf;
@@ -233,158 +340,429 @@ static void process_waiting_packet(router_t *this, packed_msg_t *pckg) {
 	this->eth_hdr->ether_type = IP_TYPE;
 
 	/* Update the ethernet header to send the packet to the next hop */
-	memcpy(this->eth_hdr->ether_dhost, this->arp_hdr->sha, MAC_ADDR_SIZE);
+	memcpy(this->eth_hdr->ether_dhost, mac, MAC_ADDR_SIZE);
 	get_interface_mac(this->interface, this->eth_hdr->ether_shost);
 }
 
-static void reinit_the_waiting_queue(router_t *this) {
+static void release_waiting_packets(worker_t *this, arp_pending_t *pending, const uint8_t *mac) {
+	router_t *router = this->router;
+
+	/*
+	 * Send every packet that was waiting for the MAC address, in the order they came.
+	 * A worker may take a released buffer right away, so they are not batched.
+	 */
+	for (arp_pending_t *iter = pending; iter != NULL; iter = iter->next) {
+		packed_msg_t *pckg = (packed_msg_t *)iter;
+
+		process_waiting_packet(this, pckg, mac);
+		send_to_link(this->interface, pckg->buf, this->len);
+	}
+
+	if (pending != NULL) {
+		pthread_mutex_lock(&router->neigh_lock);
 
-	/* Change the auxiliar queue with the waiting queue */
-	queue temp = this->pckg_queue;
-	this->pckg_queue = this->pckg_aux;
-	this->pckg_aux = temp;
+		while (pending != NULL) {
+			arp_pending_t *next = pending->next;
+
+			packet_pool_release(router->packets, pending);
+			pending = next;
+		}
+
+		pthread_mutex_unlock(&router->neigh_lock);
+	}
 }
 
-static void arp_handler(router_t *this) {
+static void slow_arp(worker_t *this) {
 	this->arp_hdr = (struct arp_header *)(this->buf + sizeof *this->eth_hdr);
 
 	/* Check if the ARP is a request or a replay */
 	if ((this->arp_hdr->op == OP_REQUEST) || (this->arp_hdr->op == OP_REPLAY)) {
+		router_t *router = this->router;
+		arp_pending_t *pending = NULL;
+		uint32_t spa = this->arp_hdr->spa;
+		uint8_t sha[MAC_ADDR_SIZE];
+		uint64_t now = now_ms();
+		int interface = this->interface;
+		size_t len = this->len;
+
+		memcpy(sha, this->arp_hdr->sha, MAC_ADDR_SIZE);
+
 		if (this->arp_hdr->op == OP_REQUEST) {
+			int for_us = (this->arp_hdr->tpa == get_interface_ipv4(this->interface)) && (spa != this->arp_hdr->tpa);
+
+			/*
+			 * The sender of a request is learned as STALE, a new entry is made
+			 * just if the request is for this router, a gratuitous ARP or a request
+			 * for another host only refreshes the MAC address of a known neighbor
+			 */
+			pthread_mutex_lock(&router->neigh_lock);
+
+			const arp_cache_entry_t *entry = arp_cache_find(router->macs, spa);
+			int reachable = (entry != NULL) && (entry->state == ARP_REACHABLE) && (memcmp(entry->mac, sha, MAC_ADDR_SIZE) == 0);
+
+			if ((spa != 0) && (arp_cache_update(router->macs, spa, sha, ARP_STALE, now, for_us) == 0)) {
 
-			/* The ARP packet is a request, generate a replay and sent it back */
-			generate_arp_replay(this);
-			send_to_link(this->interface, this->buf, this->len);
+				/* A REACHABLE neighbor learned again with the same MAC address keeps its adjacency */
+				if (!reachable) {
+					adj_table_expire(router->adjs, spa);
+				}
+
+				pending = arp_cache_take(router->macs, spa);
+			}
+
+			pthread_mutex_unlock(&router->neigh_lock);
+
+			release_waiting_packets(this, pending, sha);
+
+			if (for_us) {
+
+				/* The ARP packet is a request for this router, generate a replay and sent it back */
+				this->eth_hdr = (struct ether_header *)this->buf;
+				this->arp_hdr = (struct arp_header *)(this->buf + sizeof *this->eth_hdr);
+				this->interface = interface;
+				this->len = len;
+
+				generate_arp_replay(this);
+				send_to_link(this->interface, this->buf, this->len);
+			}
 		} else {
 
-			/* The ARP packet is a replay, cache the source MAC address */
-			cache_new_mac_addr(this->macs, this->arp_hdr->spa, this->arp_hdr->sha);
+			/* The ARP packet is a replay, confirm the MAC address of a neighbor that was asked for */
+			pthread_mutex_lock(&router->neigh_lock);
+
+			if (arp_cache_update(router->macs, spa, sha, ARP_REACHABLE, now, 0) == 0) {
+				const arp_cache_entry_t *entry = arp_cache_find(router->macs, spa);
 
-			/* Send every packet that was waiting for the received MAC address */
-			while (!queue_empty(this->pckg_queue)) {
-				packed_msg_t *pckg = queue_deq(this->pckg_queue);
+				/* The replay rewrites the adjacency right away, the next packets stay on the workers */
+				set_adjacency(router, entry, entry->interface);
+				pending = arp_cache_take(router->macs, spa);
+			}
 
-				if (pckg->hop == this->arp_hdr->spa) {
-					process_waiting_packet(this, pckg);
-					send_to_link(this->interface, pckg->buf, this->len);
-					free_packed_msg(pckg);
-				} else {
+			pthread_mutex_unlock(&router->neigh_lock);
 
-					/*
-					 * If the packet does not meet the requirements it is
-					 * sent back in the waiting queue
-					 */
-					queue_enq(this->pckg_aux, (void *)pckg);
-				}
+			release_waiting_packets(this, pending, sha);
+		}
+	}
+}
+
+static void arp_event(uint32_t ip, int interface, arp_event_t event, void *arg) {
+
+	/* A next hop that did not answer is dropped by the cache together with its packets */
+	if (event == ARP_RETRY) {
+		send_arp_request(interface, ip);
+	}
+}
+
+static void slow_packet(worker_t *this, packed_msg_t *pckg) {
+
+	/* Populate the packet data into the slow path fields */
+	this->pckg = pckg;
+	this->buf = pckg->buf;
+	this->len = pckg->len;
+	this->interface = pckg->interface;
+	this->next_hop = pckg->hop;
+	this->eth_hdr = (struct ether_header *)this->buf;
+	this->ip_hdr = (struct iphdr *)(this->buf + sizeof *this->eth_hdr);
+
+	switch (pckg->punt) {
+	case PUNT_ARP:
+		slow_arp(this);
+		break;
+	case PUNT_ECHO:
+		generate_icmp_replay(this, ICMP_RESPONE);
+		send_to_link(this->interface, this->buf, this->len);
+		break;
+	case PUNT_UNREACH:
+		generate_icmp_replay(this, ICMP_DEST_UNREACH);
+		send_to_link(this->interface, this->buf, this->len);
+		break;
+	case PUNT_TTL:
+		generate_icmp_replay(this, ICMP_TIME_EXCED);
+		send_to_link(this->interface, this->buf, this->len);
+		break;
+	case PUNT_RESOLVE:
+		slow_resolve(this);
+		break;
+	}
+
+	/* A packet that waits for its next hop is owned by the ARP cache */
+	if (this->pckg != NULL) {
+		release_packed_msg(this->router, this->pckg);
+		this->pckg = NULL;
+	}
+}
+
+static void* slow_path(void *arg) {
+	worker_t *this = (worker_t *)arg;
+	router_t *router = this->router;
+	void *pckgs[BURST_SIZE];
+	uint32_t count;
+
+	/* The slow path just sends, it also keeps the interface addresses up to date */
+	init_links(LINKS_SEND | LINKS_NETLINK);
+
+	while (atomic_load(&router->slow_stop) == 0) {
+		eventfd_t value;
+
+		/* The wake up is consumed before the ring is drained, so a later punt wakes the thread again */
+		int ready = wait_event(router->punt_fd, ARP_TICK_MS);
+
+		if (ready & WAIT_EVENT) {
+			eventfd_read(router->punt_fd, &value);
+		}
+
+		/* The source MAC address of the adjacencies may have changed together with an interface */
+		if (ready & WAIT_NETLINK) {
+			adj_table_flush(router->adjs);
+		}
+
+		while ((count = ring_dequeue_burst(router->punt, pckgs, BURST_SIZE)) != 0) {
+			for (uint32_t iter = 0; iter < count; ++iter) {
+				slow_packet(this, (packed_msg_t *)pckgs[iter]);
 			}
+		}
+
+		uint64_t now = now_ms();
 
-			/* Move the waiting packets from aux to the waiting queue */
-			reinit_the_waiting_queue(this);
+		/* The control socket just asks for the flush, the cache is changed by the router threads */
+		if (atomic_exchange(&router->flush_arp, 0) != 0) {
+			pthread_mutex_lock(&router->neigh_lock);
+			arp_cache_flush(router->macs);
+			pthread_mutex_unlock(&router->neigh_lock);
+
+			adj_table_flush(router->adjs);
+		}
+
+		if (now - router->arp_aged >= ARP_TICK_MS) {
+			router->arp_aged = now;
+
+			pthread_mutex_lock(&router->neigh_lock);
+			arp_cache_age(router->macs, now, arp_event, this);
+			pthread_mutex_unlock(&router->neigh_lock);
 		}
 	}
+
+	return NULL;
 }
 
 /**
  * @brief Initiates a router structure, computes the routing
  * table of the router following the binary trie principle,
- * allocates memory for the arp responses cache and allocated
- * memory for waiting queues and sets the the ipv4 and arp
- * handlers that are not visible for the user.
+ * allocates the packet buffers and the arp cache, which keeps
+ * the packets waiting for a next hop, and sets the the ipv4 and arp
+ * handlers that are not visible for the user. The routing
+ * table is rebuilt in the background when its file changes
+ * or when the router receives SIGHUP, and it is updated from
+ * the control socket if one is given. Every worker gets its
+ * burst buffers, the worker threads are started by the caller
+ * and the slow path thread is started last.
  * 
- * @param path 
+ * @param config the routing table, the engine and the other options of the router
  * @return router_t* 
  */
-router_t* init_router(char *path) {
-	router_t *new_router = malloc(sizeof *new_router);
+router_t* init_router(const router_config_t *config) {
+	if ((config == NULL) || (config->workers == 0)) {
+		return NULL;
+	}
 
-	if (new_router != NULL) {
-		new_router->routes = btrie_rtable(path);
+	router_t *new_router = calloc(1, sizeof *new_router);
 
-		if (new_router->routes == NULL) {
-			free(new_router);
+	if (new_router == NULL) {
+		return NULL;
+	}
 
-			return NULL;
-		}
+	pthread_mutex_init(&new_router->routes_lock, NULL);
+	pthread_mutex_init(&new_router->neigh_lock, NULL);
 
-		new_router->macs = create_vector();
+	new_router->punt_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	new_router->punt = create_ring(PUNT_RING_SIZE, RING_MULTI_PRODUCER);
+	new_router->rcu = create_rcu();
+	new_router->workers = calloc(config->workers, sizeof *new_router->workers);
 
-		if (new_router->macs == NULL) {
-			free_btrie(&new_router->routes);
-			free(new_router);
+	if ((new_router->punt_fd == -1) || (new_router->punt == NULL) || (new_router->rcu == NULL) || (new_router->workers == NULL)) {
+		free_router(new_router);
 
-			return NULL;
-		}
+		return NULL;
+	}
 
-		new_router->pckg_queue = queue_create();
+	for (uint32_t iter = 0; iter < config->workers; ++iter) {
+		new_router->workers[iter].router = new_router;
+		new_router->workers[iter].id = iter;
 
-		if (new_router->pckg_queue == NULL) {
-			free_vector(&new_router->macs);
-			free_btrie(&new_router->routes);
-			free(new_router);
+		rcu_register(new_router->rcu, &new_router->workers[iter].reader);
+		++(new_router->workers_len);
+	}
+
+	atomic_init(&new_router->routes, fib_rtable(config->engine, config->rtable));
+	new_router->packets = create_packet_pool(config->packets, sizeof(packed_msg_t));
+	new_router->macs = create_arp_cache(config->arp_capacity, drop_packed_msg, new_router->packets);
+	new_router->adjs = create_adj_table(config->arp_capacity);
+
+	if ((new_router->routes == NULL) || (new_router->packets == NULL) || (new_router->macs == NULL) ||
+		(new_router->adjs == NULL)) {
+		free_router(new_router);
+
+		return NULL;
+	}
+
+	/* The reload thread starts last, when the routing table is published */
+	new_router->reload = create_fib_reload(config->rtable, config->engine, &new_router->routes, new_router->rcu, &new_router->routes_lock);
+
+	if (new_router->reload == NULL) {
+		free_router(new_router);
+
+		return NULL;
+	}
+
+	if (config->control_path != NULL) {
+		new_router->control = create_control(config->control_path, &new_router->routes, new_router->rcu,
+											 &new_router->routes_lock, &new_router->flush_arp,
+											 get_num_interfaces());
+
+		if (new_router->control == NULL) {
+			free_router(new_router);
 
 			return NULL;
 		}
+	}
 
-		new_router->pckg_aux = queue_create();
+	/* Every worker always owns a buffer for every packet of a burst */
+	for (uint32_t iter = 0; iter < new_router->workers_len; ++iter) {
+		worker_t *worker = new_router->workers + iter;
 
-		if (new_router->pckg_aux == NULL) {
-			free_vector(&new_router->macs);
-			free_btrie(&new_router->routes);
-			queue_free(new_router->pckg_aux);
-			free(new_router);
+		for (worker->burst_index = 0; worker->burst_index < BURST_SIZE; ++worker->burst_index) {
+			packed_msg_t *pckg = packet_pool_alloc(new_router->packets);
 
-			return NULL;
+			if (pckg == NULL) {
+				free_router(new_router);
+
+				return NULL;
+			}
+
+			own_packet(worker, pckg);
 		}
 
-		new_router->ipv4 = ipv4_handler;
-		new_router->arp = arp_handler;
+		worker->burst_index = 0;
+		worker->next_hop = 0;
+		worker->interface = 0;
+	}
+
+	new_router->ipv4 = ipv4_handler;
+	new_router->arp = arp_handler;
+
+	/* The slow path starts when everything it uses is ready */
+	worker_t *slow = calloc(1, sizeof *slow);
+
+	if (slow == NULL) {
+		free_router(new_router);
 
-		new_router->next_hop = 0;
-		new_router->interface = 0;
+		return NULL;
 	}
 
+	slow->router = new_router;
+	slow->id = new_router->workers_len;
+
+	if (pthread_create(&slow->thread, NULL, slow_path, slow) != 0) {
+		free(slow);
+		free_router(new_router);
+
+		return NULL;
+	}
+
+	new_router->slow = slow;
+
 	return new_router;
 }
 
 /**
  * @brief Frees the memory allocated for the router structure.
  * However this function is called just in router faults, because
- * the router runs in a infinite loop.
+ * the router runs in a infinite loop, and before the workers
+ * are started.
  * 
  * @param router the router structure that holds the router node.
  */
 void free_router(router_t *router) {
 	if (router != NULL) {
-		if (router->pckg_aux != NULL) {
-			queue_free(router->pckg_aux);
-			router->pckg_aux = NULL;
-		}
+		if (router->slow != NULL) {
+			atomic_store(&router->slow_stop, 1);
+			eventfd_write(router->punt_fd, 1);
+			pthread_join(router->slow->thread, NULL);
 
-		if (router->pckg_queue != NULL) {
-			queue_free(router->pckg_queue);
-			router->pckg_queue = NULL;
+			free(router->slow);
 		}
 
-		if (router->macs != NULL) {
-			free_vector(&router->macs);
+		free_control(&router->control);
+		free_fib_reload(&router->reload);
+
+		/* The cache gives the waiting packets back to the pool, so it is freed first */
+		free_arp_cache(&router->macs);
+		free_packet_pool(&router->packets);
+		free_adj_table(&router->adjs);
+
+		/* No other thread uses the routing table after the writers stopped */
+		fib_t *routes = atomic_exchange(&router->routes, NULL);
+		free_fib(&routes);
+
+		if (router->rcu != NULL) {
+			for (uint32_t iter = 0; iter < router->workers_len; ++iter) {
+				rcu_unregister(router->rcu, &router->workers[iter].reader);
+			}
+
+			free_rcu(&router->rcu);
 		}
 
-		if (router->routes != NULL) {
-			free_btrie(&router->routes);
+		free(router->workers);
+		free_ring(&router->punt);
+
+		if (router->punt_fd != -1) {
+			close(router->punt_fd);
 		}
 
+		pthread_mutex_destroy(&router->neigh_lock);
+		pthread_mutex_destroy(&router->routes_lock);
+
 		free(router);
 	}
 }
 
+/**
+ * @brief Prepares the calling thread to run a worker. The worker
+ * opens its own sockets on every interface, with more workers the
+ * sockets join a fanout group that spreads the flows over them,
+ * and every worker is pinned to a core.
+ * 
+ * @param worker the worker run by the calling thread.
+ */
+void start_worker(worker_t *worker) {
+	if (worker != NULL) {
+		router_t *router = worker->router;
+
+		init_links((router->workers_len > 1) ? LINKS_FANOUT : 0);
+
+		if (router->workers_len > 1) {
+			long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+			cpu_set_t set;
+
+			CPU_ZERO(&set);
+			CPU_SET((cpus > 0) ? (worker->id % (uint32_t)cpus) : 0, &set);
+
+			/* A worker that can not be pinned still forwards, just the scheduler moves it */
+			if (pthread_setaffinity_np(pthread_self(), sizeof set, &set) != 0) {
+				DEBUG("Could not pin the worker to a core");
+			}
+		}
+	}
+}
+
 /**
  * @brief Checks if the packet received is of ipv4 type.
  * 
- * @param router the router structure that holds the router node.
+ * @param worker the worker that handles the packet.
  * @return uint8_t 1 if the packet is of ipv4 type or 0 otherwise.
  */
-uint8_t packet_is_ipv4(router_t *router) {
-	if ((router == NULL) || (router->eth_hdr->ether_type != IP_TYPE)) {
+uint8_t packet_is_ipv4(worker_t *worker) {
+	if ((worker == NULL) || (worker->eth_hdr->ether_type != IP_TYPE)) {
 		return 0;
 	}
 
@@ -394,11 +772,11 @@ uint8_t packet_is_ipv4(router_t *router) {
 /**
  * @brief Checks if the packet received is of arp type.
  * 
- * @param router the router structure that holds the router node.
+ * @param worker the worker that handles the packet.
  * @return uint8_t 1 if the packet is of arp type or 0 otherwise.
  */
-uint8_t packet_is_arp(router_t *router) {
-	if ((router == NULL) || (router->eth_hdr->ether_type != ARP_TYPE)) {
+uint8_t packet_is_arp(worker_t *worker) {
+	if ((worker == NULL) || (worker->eth_hdr->ether_type != ARP_TYPE)) {
 		return 0;
 	}
 
@@ -406,30 +784,108 @@ uint8_t packet_is_arp(router_t *router) {
 }
 
 /**
- * @brief Blockant action that waits to receive a packet
- * from the network.
+ * @brief Blockant action that waits to receive a burst of
+ * packets from the network.
  * 
- * @param router the router structure that holds the router node.
- * @return int the interface that received the packet.
+ * @param worker the worker that receives the packets.
+ * @return int the number of packets received or -1 on failure.
  */
-int recv_msg(router_t *router) {
-	if (router != NULL) {
-		router->len = 0;
+int recv_msgs(worker_t *worker) {
+	if (worker != NULL) {
+		router_t *router = worker->router;
+
+		for (int iter = 0; iter < BURST_SIZE; ++iter) {
+			worker->frames[iter].data = worker->burst[iter]->buf;
+		}
+
+		while (1) {
+
+			/* A blocked thread must not delay the release of a replaced routing table */
+			rcu_offline(&worker->reader);
+			int count = recv_burst_from_any_link(worker->frames, BURST_SIZE, -1);
+			rcu_online(router->rcu, &worker->reader);
+
+			if (count > 0) {
+				worker->burst_len = count;
 
-		return recv_from_any_link(router->buf, &router->len);
+				return count;
+			}
+		}
 	}
 
 	return -1;
 }
 
 /**
- * @brief Initiate the ethernet header of the received packet
- * into the router structure.
+ * @brief Matches the destinations of the IPv4 packets of the received
+ * burst with a single batch lookup, so the walks of the routing table
+ * overlap their memory accesses instead of waiting for them one by one.
+ * The handlers read the route of their packet from the worker.
  * 
- * @param router the router structure that holds the router node.
+ * @param worker the worker that received the burst.
  */
-void init_msg_fields(router_t *router) {
-	if (router != NULL) {
-		router->eth_hdr = (struct ether_header *)router->buf;
+void lookup_msgs(worker_t *worker) {
+	if (worker != NULL) {
+		uint32_t addrs[BURST_SIZE];
+		hop_info_t routes[BURST_SIZE];
+		int indexes[BURST_SIZE];
+		size_t count = 0;
+
+		for (int iter = 0; iter < worker->burst_len; ++iter) {
+			const struct ether_header *eth_hdr = (const struct ether_header *)worker->frames[iter].data;
+
+			worker->routes[iter].status = INVALID;
+
+			if ((worker->frames[iter].len >= sizeof *eth_hdr + sizeof(struct iphdr)) && (eth_hdr->ether_type == IP_TYPE)) {
+				addrs[count] = ((const struct iphdr *)(eth_hdr + 1))->daddr;
+				indexes[count++] = iter;
+			}
+		}
+
+		if (count != 0) {
+			fib_t *fib = atomic_load_explicit(&worker->router->routes, memory_order_acquire);
+
+			fib_lookup_batch(fib, addrs, routes, count);
+
+			for (size_t iter = 0; iter < count; ++iter) {
+				worker->routes[indexes[iter]] = routes[iter];
+			}
+		}
 	}
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Selects a packet of the received burst as the current
+ * packet and initiates its ethernet header into the worker structure.
+ * 
+ * @param worker the worker that handles the packet.
+ * @param index the index of the packet in the burst.
+ */
+void init_msg_fields(worker_t *worker, int index) {
+	if ((worker != NULL) && (index >= 0) && (index < worker->burst_len)) {
+		worker->burst_index = index;
+		worker->pckg = worker->burst[index];
+		worker->buf = worker->frames[index].data;
+		worker->len = worker->frames[index].len;
+		worker->interface = worker->frames[index].interface;
+		worker->eth_hdr = (struct ether_header *)worker->buf;
+	}
+}
+
+/**
+ * @brief Sends the packets queued while the burst was handled,
+ * the buffers of the burst are reused only after this call, and
+ * wakes up the slow path if packets were punted to it.
+ * 
+ * @param worker the worker that handled the burst.
+ */
+void send_msgs(worker_t *worker) {
+	if (worker != NULL) {
+		flush_links();
+
+		if (worker->punted != 0) {
+			eventfd_write(worker->router->punt_fd, 1);
+			worker->punted = 0;
+		}
+	}
+}
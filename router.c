@@ -1,32 +1,115 @@
+#include <getopt.h>
+#include <unistd.h>
+
 #include "utils.h"
 
-int main(int argc, char *argv[]) {
-	init(argc - 2, argv + 2);
+static void usage(const char *name) {
+	fprintf(stderr, "Usage: %s [-f trie|dir24-8|poptrie|bsl] [-c control_socket] [-a arp_entries] [-p packets] [-i socket|ring] [-w workers] rtable interface...\n", name);
+	exit(-1);
+}
+
+static void* forward(void *arg) {
+	worker_t *worker = (worker_t *)arg;
+	router_t *router = worker->router;
 
-	router_t *router = init_router(argv[1]);
+	start_worker(worker);
 
 	while (1) {
-		router->interface = recv_msg(router);
-		
-		if (router->interface < 0) {
-			free_router(router);
+		int count = recv_msgs(worker);
 
+		if (count < 0) {
 			DEBUG("Interfaces are corrupted!!!");
 
 			exit(-1);
 		}
 
-		init_msg_fields(router);
+		/* The routes of the whole burst are matched at once, before the packets are handled */
+		lookup_msgs(worker);
 
-		if (packet_is_ipv4(router) || packet_is_arp(router)) {
-			if (packet_is_ipv4(router)) {
-				router->ipv4(router);
+		for (int iter = 0; iter < count; ++iter) {
+			init_msg_fields(worker, iter);
+
+			if (packet_is_ipv4(worker) || packet_is_arp(worker)) {
+				if (packet_is_ipv4(worker)) {
+					router->ipv4(worker);
+				} else {
+					router->arp(worker);
+				}
 			} else {
-				router->arp(router);
+				DEBUG("Type unidentified...dropping.");
 			}
-		} else {
-			DEBUG("Type unidentified...dropping.");
 		}
+
+		/* The whole burst leaves with a sendmmsg call per interface */
+		send_msgs(worker);
 	}
+
+	return NULL;
 }
 
+int main(int argc, char *argv[]) {
+	router_config_t config = {
+		.engine = "trie",
+		.control_path = NULL,
+		.arp_capacity = ARP_CACHE_DEFAULT_CAPACITY,
+		.packets = PACKET_POOL_DEFAULT_SIZE,
+		.workers = 1,
+		.backend = IO_BACKEND_SOCKET
+	};
+	int opt;
+
+	while ((opt = getopt(argc, argv, "+f:c:a:p:i:w:")) != -1) {
+		if ((opt == 'f') && (fib_find_ops(optarg) != NULL)) {
+			config.engine = optarg;
+		} else if (opt == 'c') {
+			config.control_path = optarg;
+		} else if ((opt == 'a') && (atoi(optarg) > 0)) {
+			config.arp_capacity = (uint32_t)atoi(optarg);
+		} else if ((opt == 'p') && (atoi(optarg) > 0)) {
+			config.packets = (uint32_t)atoi(optarg);
+		} else if ((opt == 'i') && ((strcmp(optarg, "socket") == 0) || (strcmp(optarg, "ring") == 0))) {
+			config.backend = (strcmp(optarg, "ring") == 0) ? IO_BACKEND_RING : IO_BACKEND_SOCKET;
+		} else if ((opt == 'w') && (atoi(optarg) >= 0)) {
+			config.workers = (uint32_t)atoi(optarg);
+		} else {
+			usage(argv[0]);
+		}
+	}
+
+	if (argc - optind < 2) {
+		usage(argv[0]);
+	}
+
+	config.rtable = argv[optind];
+
+	/* No workers given means a worker for every core */
+	if (config.workers == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		config.workers = (cpus > 0) ? (uint32_t)cpus : 1;
+	}
+
+	init_backend(argc - optind - 1, argv + optind + 1, config.backend);
+
+	router_t *router = init_router(&config);
+
+	if (router == NULL) {
+		DEBUG("Could not build the routing table!!!");
+
+		exit(-1);
+	}
+
+	/* The main thread runs the first worker, the slow path thread is already running */
+	for (uint32_t iter = 1; iter < router->workers_len; ++iter) {
+		if (pthread_create(&router->workers[iter].thread, NULL, forward, router->workers + iter) != 0) {
+			DEBUG("Could not start the workers!!!");
+
+			exit(-1);
+		}
+	}
+
+	router->workers[0].thread = pthread_self();
+	forward(router->workers);
+
+	return 0;
+}
@@ -0,0 +1,29 @@
+#include "binary_trie.h"
+#include "btrie_image.h"
+
+int main(int argc, char *argv[]) {
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s rtable image\n", argv[0]);
+		exit(-1);
+	}
+
+	btrie_t *rtable = btrie_rtable(argv[1]);
+
+	if (rtable == NULL) {
+		fprintf(stderr, "Could not read the routing table %s\n", argv[1]);
+		exit(-1);
+	}
+
+	if (btrie_save(rtable, argv[2]) != 0) {
+		fprintf(stderr, "Could not write the image %s\n", argv[2]);
+		free_btrie(&rtable);
+		exit(-1);
+	}
+
+	printf("%zu routes, %u nodes, %u hops written to %s\n",
+		rtable->size, rtable->nodes_len, rtable->hops_len, argv[2]);
+
+	free_btrie(&rtable);
+
+	return 0;
+}
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+
+#include "csum.h"
+
+#define CSUM_TEST_BUF_SIZE 4096
+#define CSUM_TEST_ROUNDS 20000
+#define CSUM_TEST_HEADERS 200000
+#define CSUM_TEST_IP_HEADER 20
+#define CSUM_TEST_IP_CHECK 10
+#define CSUM_TEST_IP_TTL 8
+#define CSUM_TEST_IP_SADDR 12
+
+static int failures;
+
+#define CHECK(condition, ...) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            ++failures; \
+        } \
+    } while (0)
+
+static uint64_t test_state = 0x9e3779b97f4a7c15ull;
+
+static uint32_t test_random(void) {
+    test_state ^= test_state << 13;
+    test_state ^= test_state >> 7;
+    test_state ^= test_state << 17;
+
+    return (uint32_t)test_state;
+}
+
+/**
+ * @brief The checksum of RFC 1071 over big endian 16-bit words, one
+ * at a time, stored in network order like the checksum of a header.
+ */
+static uint16_t reference_csum(const uint8_t *data, size_t len) {
+    uint32_t sum = 0;
+
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        sum += ((uint32_t)data[i] << 8) | data[i + 1];
+    }
+
+    if ((len & 1) != 0) {
+        sum += (uint32_t)data[len - 1] << 8;
+    }
+
+    while ((sum >> 16) != 0) {
+        sum = (sum & 0xffffu) + (sum >> 16);
+    }
+
+    return htons((uint16_t)~sum);
+}
+
+static void fill_random(uint8_t *data, size_t len, int pattern) {
+    for (size_t i = 0; i < len; ++i) {
+
+        /* The all-ones data carries on every word, the random data covers the rest */
+        data[i] = (pattern == 0) ? 0xff : (uint8_t)test_random();
+    }
+}
+
+static void test_partial(const char *kernel) {
+    static uint8_t buf[CSUM_TEST_BUF_SIZE + 64];
+
+    if (csum_select_kernel(kernel) != 0) {
+        printf("csum_partial %s: not supported, skipped\n", kernel);
+        return;
+    }
+
+    for (int round = 0; round < CSUM_TEST_ROUNDS; ++round) {
+        size_t offset = test_random() % 64;
+        size_t len = test_random() % (((round % 10) == 0) ? CSUM_TEST_BUF_SIZE : 256);
+
+        fill_random(buf + offset, len, round % 7);
+
+        uint16_t expected = reference_csum(buf + offset, len);
+        uint16_t whole = csum_fold(csum_partial(buf + offset, len, 0));
+
+        CHECK(whole == expected, "%s: offset %zu len %zu got %04x expected %04x", kernel, offset, len, whole, expected);
+
+        /* A partial sum is continued after an even number of bytes */
+        size_t split = (test_random() % (len + 1)) & ~(size_t)1;
+        uint16_t parts = csum_fold(csum_partial(buf + offset + split, len - split, csum_partial(buf + offset, split, 0)));
+
+        CHECK(parts == expected, "%s: offset %zu len %zu split %zu got %04x expected %04x", kernel, offset, len, split,
+              parts, expected);
+    }
+
+    printf("csum_partial %s: ok\n", kernel);
+}
+
+static void make_header(uint8_t *header) {
+    fill_random(header, CSUM_TEST_IP_HEADER, 1);
+
+    /* A version 4 header of 20 bytes with a TTL that can be decremented */
+    header[0] = 0x45;
+    header[CSUM_TEST_IP_TTL] = (uint8_t)(2 + test_random() % 254);
+    header[CSUM_TEST_IP_CHECK] = 0;
+    header[CSUM_TEST_IP_CHECK + 1] = 0;
+
+    uint16_t check = reference_csum(header, CSUM_TEST_IP_HEADER);
+    memcpy(header + CSUM_TEST_IP_CHECK, &check, sizeof check);
+}
+
+static uint16_t recompute_check(uint8_t *header) {
+    header[CSUM_TEST_IP_CHECK] = 0;
+    header[CSUM_TEST_IP_CHECK + 1] = 0;
+
+    return reference_csum(header, CSUM_TEST_IP_HEADER);
+}
+
+static void test_updates(void) {
+    uint8_t header[CSUM_TEST_IP_HEADER];
+
+    for (int round = 0; round < CSUM_TEST_HEADERS; ++round) {
+        uint16_t check, old_word, new_word, updated;
+
+        make_header(header);
+        memcpy(&check, header + CSUM_TEST_IP_CHECK, sizeof check);
+
+        CHECK(csum_fold(csum_partial(header, CSUM_TEST_IP_HEADER, 0)) == 0, "a valid header does not fold to 0");
+
+        /* The forwarding case, the TTL shares its word with the protocol */
+        memcpy(&old_word, header + CSUM_TEST_IP_TTL, sizeof old_word);
+        header[CSUM_TEST_IP_TTL] -= 1;
+        memcpy(&new_word, header + CSUM_TEST_IP_TTL, sizeof new_word);
+
+        updated = csum_update16(check, old_word, new_word);
+        check = recompute_check(header);
+
+        CHECK(updated == check, "ttl decrement got %04x expected %04x", updated, check);
+        memcpy(header + CSUM_TEST_IP_CHECK, &updated, sizeof updated);
+        CHECK(csum_fold(csum_partial(header, CSUM_TEST_IP_HEADER, 0)) == 0, "the updated header does not fold to 0");
+
+        /* Any other 16-bit word, the checksum itself excluded */
+        size_t word = 2 * (test_random() % (CSUM_TEST_IP_HEADER / 2));
+
+        if (word != CSUM_TEST_IP_CHECK) {
+            memcpy(&old_word, header + word, sizeof old_word);
+            new_word = ((round % 5) == 0) ? 0 : (((round % 11) == 0) ? 0xffff : (uint16_t)test_random());
+            memcpy(header + word, &new_word, sizeof new_word);
+
+            updated = csum_update16(updated, old_word, new_word);
+            check = recompute_check(header);
+
+            CHECK(updated == check, "word %zu got %04x expected %04x", word, updated, check);
+            memcpy(header + CSUM_TEST_IP_CHECK, &updated, sizeof updated);
+        }
+
+        /* A source address rewrite, as a 32-bit update */
+        uint32_t old_addr, new_addr = test_random();
+
+        memcpy(&old_addr, header + CSUM_TEST_IP_SADDR, sizeof old_addr);
+        memcpy(header + CSUM_TEST_IP_SADDR, &new_addr, sizeof new_addr);
+
+        updated = csum_update32(updated, old_addr, new_addr);
+        check = recompute_check(header);
+
+        CHECK(updated == check, "address got %04x expected %04x", updated, check);
+    }
+
+    printf("csum_update16/csum_update32: ok\n");
+}
+
+int main(void) {
+    const char *chosen = csum_kernel();
+
+    test_partial("scalar");
+    test_partial("sse2");
+    test_partial("avx2");
+    csum_select_kernel(chosen);
+
+    test_updates();
+
+    if (failures != 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}